@@ -0,0 +1,389 @@
+#pragma once
+
+// an ini file read into memory once, so that looking up every key doesn't open and parse the
+// whole file again as minIni does. added and changed keys are kept in memory as well, and written
+// back together by save(), so a startup costs one read and at most one write.
+// only meant for small files such as config.ini, see IniTable::MAX_SIZE.
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <strings.h>
+#include <utility>
+#include "minIni/minGlue.h"
+
+namespace {
+
+class IniTable {
+public:
+    static constexpr u32 MAX_SIZE = 0x1000; // of the file plus the added keys
+    static constexpr u32 MAX_ENTRIES = 64;
+    static constexpr u32 MAX_SECTIONS = 16;
+
+    // reads and parses the file, a missing file is the same as an empty one.
+    // returns false if the file doesn't fit, then only the part that did is looked at
+    // and save() leaves the file alone
+    auto load(const char* path) -> bool {
+        struct NxFile file{};
+        u64 bytes_read{};
+        s64 file_size{};
+
+        text_size = arena_size = 0;
+        section_count = count = 0;
+        dirty = false;
+        // keys before the first section
+        sections[section_count++] = {};
+
+        if (ini_openread(path, &file)) {
+            if (R_FAILED(fsFileGetSize(&file.file, &file_size)) ||
+                R_FAILED(fsFileRead(&file.file, 0, arena, sizeof(arena), FsReadOption_None, &bytes_read))) {
+                bytes_read = 0;
+            }
+            ini_close(&file);
+        }
+
+        text_size = arena_size = bytes_read;
+        truncated = static_cast<u64>(file_size) > sizeof(arena);
+        parse();
+        return !truncated;
+    }
+
+    auto has_key(const char* section, const char* key) const -> bool {
+        return find(section, key);
+    }
+
+    // same as ini_getbool
+    auto get_bool(const char* section, const char* key, bool _default) const -> bool {
+        const auto e = find(section, key);
+        if (!e || !e->value.size) {
+            return _default;
+        }
+
+        switch (std::toupper(arena[e->value.offset])) {
+            case '1': case 'Y': case 'T': return true;
+            case '0': case 'N': case 'F': return false;
+            default: return _default;
+        }
+    }
+
+    // adds the key at the end of its section, or in a new section at the end of the file.
+    // keys that are already there are left as they are. returns false if it doesn't fit
+    auto add(const char* section, const char* key, long value) -> bool {
+        if (find(section, key)) {
+            return true;
+        }
+
+        char value_str[24]{};
+        std::snprintf(value_str, sizeof(value_str), "%ld", value);
+        return add_value(section, key, value_str);
+    }
+
+    // same as add(), but keys that are already there get the new value.
+    // only the value is replaced in the file, comments and quotes around it are kept
+    auto set(const char* section, const char* key, long value) -> bool {
+        char value_str[24]{};
+        std::snprintf(value_str, sizeof(value_str), "%ld", value);
+
+        const auto e = find(section, key);
+        if (!e) {
+            return add_value(section, key, value_str);
+        }
+        if (equals(e->value, value_str, std::strlen(value_str))) {
+            return true;
+        }
+
+        const auto value_span = store(value_str);
+        if (value_span.offset == FULL) {
+            return false;
+        }
+        e->value = value_span;
+        e->changed = !e->added;
+        dirty = true;
+        return true;
+    }
+
+    // writes the file back if anything was added or changed, all at once into a temporary
+    // file which then replaces it, same as minIni
+    auto save(const char* path) -> bool {
+        if (!dirty) {
+            return true;
+        }
+        if (truncated) {
+            return false;
+        }
+
+        // big enough for the arena plus the '=', newlines and brackets of what was added
+        static char out[MAX_SIZE + (MAX_ENTRIES + MAX_SECTIONS) * 4];
+        u32 size{};
+
+        const auto emit = [&](const char* s, u32 len) {
+            std::memcpy(out + size, s, len);
+            size += len;
+        };
+
+        const auto emit_entries = [&](u8 s) {
+            for (const auto& e : std::span{entries, count}) {
+                if (e.added && e.section == s) {
+                    emit(arena + e.key.offset, e.key.size);
+                    emit("=", 1);
+                    emit(arena + e.value.offset, e.value.size);
+                    emit("\n", 1);
+                }
+            }
+        };
+
+        // changed values are replaced where they are, and added keys of existing sections
+        // go after their last key, in the order of the file
+        u32 pos{};
+        for (u8 s = 0; s < section_count; s++) {
+            if (sections[s].end == NEW_SECTION) {
+                continue;
+            }
+
+            for (const auto& e : std::span{entries, count}) {
+                if (e.changed && e.section == s) {
+                    emit(arena + pos, e.in_file.offset - pos);
+                    emit(arena + e.value.offset, e.value.size);
+                    pos = e.in_file.offset + e.in_file.size;
+                }
+            }
+
+            if (!has_added(s)) {
+                continue;
+            }
+
+            emit(arena + pos, sections[s].end - pos);
+            pos = sections[s].end;
+            if (pos && arena[pos - 1] != '\n') {
+                emit("\n", 1);
+            }
+            emit_entries(s);
+        }
+        emit(arena + pos, text_size - pos);
+
+        for (u8 s = 0; s < section_count; s++) {
+            if (sections[s].end != NEW_SECTION) {
+                continue;
+            }
+
+            if (size && out[size - 1] != '\n') {
+                emit("\n", 1);
+            }
+            emit("[", 1);
+            emit(arena + sections[s].name.offset, sections[s].name.size);
+            emit("]\n", 2);
+            emit_entries(s);
+        }
+        out[size] = '\0';
+
+        // same name as minIni's temporary file
+        char temp_path[FS_MAX_PATH]{};
+        std::strncpy(temp_path, path, sizeof(temp_path) - 1);
+        temp_path[std::strlen(temp_path) - 1] = '~';
+
+        struct NxFile file{};
+        ini_remove(temp_path);
+        if (!ini_openwrite(temp_path, &file)) {
+            return false;
+        }
+        const auto written = ini_write(out, &file);
+        ini_close(&file);
+
+        if (!written) {
+            ini_remove(temp_path);
+            return false;
+        }
+
+        ini_remove(path);
+        dirty = !ini_rename(temp_path, path);
+        return !dirty;
+    }
+
+private:
+    static constexpr u16 FULL = 0xFFFF; // offset of a span that didn't fit
+    static constexpr u16 NEW_SECTION = 0xFFFF; // end of a section that isn't in the file yet
+
+    // part of the arena
+    struct Span {
+        u16 offset;
+        u16 size;
+    };
+
+    struct Section {
+        Span name;
+        u16 end; // in the file, right after its last key
+    };
+
+    struct Entry {
+        u8 section; // index into sections
+        Span key;
+        Span value;
+        Span in_file; // of the value in the file, replaced by save() once it's changed
+        bool added; // not in the file yet
+        bool changed; // in the file, with a different value
+    };
+
+    char arena[MAX_SIZE]; // the file as read, then the added names and values
+    u32 text_size; // of the file
+    u32 arena_size;
+    Section sections[MAX_SECTIONS];
+    Entry entries[MAX_ENTRIES];
+    u8 section_count;
+    u8 count;
+    bool dirty; // anything was added or changed
+    bool truncated; // the file didn't fit in the arena
+
+    static auto is_space(char c) -> bool {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // the span of [begin, end) without the whitespace around it
+    auto trim(u32 begin, u32 end) const -> Span {
+        while (begin < end && is_space(arena[begin])) {
+            begin++;
+        }
+        while (end > begin && is_space(arena[end - 1])) {
+            end--;
+        }
+        return { static_cast<u16>(begin), static_cast<u16>(end - begin) };
+    }
+
+    // same rules as minIni: a value is either quoted, or ends at a comment
+    auto clean_value(Span v) const -> Span {
+        if (v.size >= 2 && arena[v.offset] == '"') {
+            for (u16 i = 1; i < v.size; i++) {
+                if (arena[v.offset + i] == '"') {
+                    return { static_cast<u16>(v.offset + 1), static_cast<u16>(i - 1) };
+                }
+            }
+        }
+
+        for (u16 i = 0; i < v.size; i++) {
+            if (arena[v.offset + i] == ';' || arena[v.offset + i] == '#') {
+                return trim(v.offset, v.offset + i);
+            }
+        }
+        return v;
+    }
+
+    void parse() {
+        u8 section{};
+        for (u32 line = 0; line < text_size;) {
+            u32 line_end = line;
+            while (line_end < text_size && arena[line_end] != '\n') {
+                line_end++;
+            }
+            const u32 next = line_end < text_size ? line_end + 1 : line_end;
+            const auto l = trim(line, line_end);
+            const auto c = l.size ? arena[l.offset] : ';';
+
+            if (c == '[') {
+                // the last ']' closes the name
+                u32 close = l.offset + l.size;
+                while (close > l.offset && arena[close - 1] != ']') {
+                    close--;
+                }
+                if (close > l.offset + 1U && section_count < MAX_SECTIONS) {
+                    section = section_count++;
+                    sections[section] = { trim(l.offset + 1, close - 1), static_cast<u16>(next) };
+                }
+            } else if (c != ';' && c != '#') {
+                u32 sep = l.offset;
+                while (sep < l.offset + l.size && arena[sep] != '=' && arena[sep] != ':') {
+                    sep++;
+                }
+
+                if (sep < l.offset + l.size && count < MAX_ENTRIES) {
+                    const auto value = clean_value(trim(sep + 1, l.offset + l.size));
+                    entries[count++] = { section, trim(l.offset, sep), value, value, false, false };
+                    sections[section].end = next;
+                }
+            }
+
+            line = next;
+        }
+    }
+
+    // appends a copy of s to the arena
+    auto store(const char* s) -> Span {
+        const auto len = std::strlen(s);
+        if (arena_size + len > sizeof(arena)) {
+            return { FULL, 0 };
+        }
+
+        std::memcpy(arena + arena_size, s, len);
+        const Span span{ static_cast<u16>(arena_size), static_cast<u16>(len) };
+        arena_size += len;
+        return span;
+    }
+
+    // case insensitive, as in minIni
+    auto equals(Span span, const char* s, size_t len) const -> bool {
+        return span.size == len && !strncasecmp(arena + span.offset, s, len);
+    }
+
+    auto find_section(const char* name, size_t len) const -> s32 {
+        for (u8 s = 0; s < section_count; s++) {
+            if (equals(sections[s].name, name, len)) {
+                return s;
+            }
+        }
+        return -1;
+    }
+
+    auto find(const char* section, const char* key) const -> const Entry* {
+        const auto s = find_section(section, std::strlen(section));
+        if (s < 0) {
+            return nullptr;
+        }
+
+        const auto len = std::strlen(key);
+        for (const auto& e : std::span{entries, count}) {
+            if (e.section == s && equals(e.key, key, len)) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    auto find(const char* section, const char* key) -> Entry* {
+        return const_cast<Entry*>(std::as_const(*this).find(section, key));
+    }
+
+    // adds a key that isn't there yet
+    auto add_value(const char* section, const char* key, const char* value_str) -> bool {
+        auto s = find_section(section, std::strlen(section));
+        if (count == MAX_ENTRIES || (s < 0 && section_count == MAX_SECTIONS)) {
+            return false;
+        }
+
+        const auto arena_start = arena_size;
+        const auto section_span = s < 0 ? store(section) : Span{};
+        const auto key_span = store(key);
+        const auto value_span = store(value_str);
+        if (section_span.offset == FULL || key_span.offset == FULL || value_span.offset == FULL) {
+            arena_size = arena_start;
+            return false;
+        }
+
+        if (s < 0) {
+            s = section_count++;
+            sections[s] = { section_span, NEW_SECTION };
+        }
+        entries[count++] = { static_cast<u8>(s), key_span, value_span, {}, true, false };
+        dirty = true;
+        return true;
+    }
+
+    auto has_added(u8 s) const -> bool {
+        for (const auto& e : std::span{entries, count}) {
+            if (e.added && e.section == s) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace
@@ -0,0 +1,62 @@
+#pragma once
+
+// builds a whole ini file in memory and writes it out in one go, for files that are written
+// from scratch such as log.ini. each ini_puts() of minIni copies the file into a temporary
+// file and renames it back, so writing n keys with it costs n full rewrites of the file.
+// sections are written in the order they're first used, keys aren't checked for duplicates.
+// meant to be static, so that it starts out empty.
+
+#include <cstdio>
+#include <cstring>
+#include "minIni/minGlue.h"
+
+namespace {
+
+class IniWriter {
+public:
+    static constexpr u32 MAX_SIZE = 0x1000;
+
+    void put(const char* section_name, const char* key, const char* value) {
+        const auto new_section = std::strcmp(section, section_name) != 0;
+        const auto len = (new_section ? std::strlen(section_name) + 3 : 0) + std::strlen(key) + std::strlen(value) + 2;
+
+        // lines that don't fit are dropped, so that the file stays readable
+        if (size + len >= sizeof(buffer)) {
+            full = true;
+            return;
+        }
+
+        if (new_section) {
+            std::snprintf(section, sizeof(section), "%s", section_name);
+            size += std::sprintf(buffer + size, "[%s]\n", section_name);
+        }
+        size += std::sprintf(buffer + size, "%s=%s\n", key, value);
+    }
+
+    void put(const char* section_name, const char* key, long value) {
+        char value_str[24]{};
+        std::snprintf(value_str, sizeof(value_str), "%ld", value);
+        put(section_name, key, value_str);
+    }
+
+    // replaces the file with what was put. returns false if it couldn't be written,
+    // or if anything had to be dropped
+    auto save(const char* path) -> bool {
+        struct NxFile file{};
+        ini_remove(path);
+        if (!ini_openwrite(path, &file)) {
+            return false;
+        }
+        const auto written = ini_write(buffer, &file);
+        ini_close(&file);
+        return written && !full;
+    }
+
+private:
+    char buffer[MAX_SIZE];
+    char section[64]; // of the last line
+    u32 size;
+    bool full; // a line didn't fit
+};
+
+} // namespace
@@ -1,34 +1,102 @@
 #include "minGlue.h"
 #include <string.h>
 
+#ifndef INI_READ_BLOCK_SIZE
+#define INI_READ_BLOCK_SIZE 0x1000
+#endif
+
+// lines are handed out of a block of the file, instead of reading the file again for each line.
+// a file smaller than the block is read whole. minIni only reads one file at a time, so there's
+// a single block, of the file that was read last
+static struct {
+    const struct NxFile* owner;
+    s64 offset; // of the block in the file
+    u64 size;
+    char data[INI_READ_BLOCK_SIZE];
+} block;
+
+static bool block_fill(struct NxFile* nxfile) {
+    u64 bytes_read = {0};
+
+    block.owner = NULL;
+    if (R_FAILED(fsFileRead(&nxfile->file, nxfile->offset, block.data, sizeof(block.data), FsReadOption_None, &bytes_read))) {
+        return false;
+    }
+
+    block.owner = nxfile;
+    block.offset = nxfile->offset;
+    block.size = bytes_read;
+    return true;
+}
+
+static void block_drop(const struct NxFile* nxfile) {
+    if (block.owner == nxfile) {
+        block.owner = NULL;
+    }
+}
+
+static FsFileSystem sd_fs;
+static bool sd_fs_open;
+
+bool ini_fs_init(void) {
+    if (!sd_fs_open) {
+        sd_fs_open = R_SUCCEEDED(fsOpenSdCardFileSystem(&sd_fs));
+    }
+    return sd_fs_open;
+}
+
+void ini_fs_exit(void) {
+    if (sd_fs_open) {
+        fsFsClose(&sd_fs);
+        sd_fs_open = false;
+    }
+}
+
+FsFileSystem* ini_fs_open(FsFileSystem* fs) {
+    if (sd_fs_open) {
+        return &sd_fs;
+    }
+    if (R_FAILED(fsOpenSdCardFileSystem(fs))) {
+        return NULL;
+    }
+    return fs;
+}
+
+void ini_fs_close(FsFileSystem* fs) {
+    if (fs != &sd_fs) {
+        fsFsClose(fs);
+    }
+}
+
 static bool ini_open(const char* filename, struct NxFile* nxfile, u32 mode) {
     Result rc = {0};
     char filename_buf[FS_MAX_PATH] = {0};
 
-    if (R_FAILED(rc = fsOpenSdCardFileSystem(&nxfile->system))) {
+    if ((nxfile->fs = ini_fs_open(&nxfile->system)) == NULL) {
         return false;
     }
 
     strcpy(filename_buf, filename);
 
-    if (R_FAILED(rc = fsFsOpenFile(&nxfile->system, filename_buf, mode, &nxfile->file))) {
+    if (R_FAILED(rc = fsFsOpenFile(nxfile->fs, filename_buf, mode, &nxfile->file))) {
         if (mode & FsOpenMode_Write) {
-            if (R_FAILED(rc = fsFsCreateFile(&nxfile->system, filename_buf, 0, 0))) {
-                fsFsClose(&nxfile->system);
+            if (R_FAILED(rc = fsFsCreateFile(nxfile->fs, filename_buf, 0, 0))) {
+                ini_fs_close(nxfile->fs);
                 return false;
             } else {
-                if (R_FAILED(rc = fsFsOpenFile(&nxfile->system, filename_buf, mode, &nxfile->file))) {
-                    fsFsClose(&nxfile->system);
+                if (R_FAILED(rc = fsFsOpenFile(nxfile->fs, filename_buf, mode, &nxfile->file))) {
+                    ini_fs_close(nxfile->fs);
                     return false;
                 }
             }
         } else {
-            fsFsClose(&nxfile->system);
+            ini_fs_close(nxfile->fs);
             return false;
         }
     }
 
     nxfile->offset = 0;
+    block_drop(nxfile);
     return true;
 }
 
@@ -45,38 +113,60 @@ bool ini_openrewrite(const char* filename, struct NxFile* nxfile) {
 }
 
 bool ini_close(struct NxFile* nxfile) {
+    block_drop(nxfile);
     fsFileClose(&nxfile->file);
-    fsFsClose(&nxfile->system);
+    ini_fs_close(nxfile->fs);
     return true;
 }
 
 bool ini_read(char* buffer, u64 size, struct NxFile* nxfile) {
-    u64 bytes_read = {0};
-    if (R_FAILED(fsFileRead(&nxfile->file, nxfile->offset, buffer, size, FsReadOption_None, &bytes_read))) {
+    if (!size) {
         return false;
     }
 
-    if (!bytes_read) {
+    // room for the terminator
+    const u64 max_len = size - 1;
+    const bool in_block = block.owner == nxfile && nxfile->offset >= block.offset && nxfile->offset < block.offset + (s64)block.size;
+
+    if (!in_block) {
+        if (!block_fill(nxfile)) {
+            return false;
+        }
+    } else {
+        // the line might go on past the block, unless the block ends the file
+        const u64 avail = block.offset + block.size - nxfile->offset;
+        const char* start = block.data + (nxfile->offset - block.offset);
+        if (avail < max_len && !memchr(start, '\n', avail) && block.size == sizeof(block.data) && !block_fill(nxfile)) {
+            return false;
+        }
+    }
+
+    const u64 avail = block.offset + block.size - nxfile->offset;
+    const char* start = block.data + (nxfile->offset - block.offset);
+    if (!avail) {
         return false;
     }
 
-    char *eol = {0};
+    u64 len = avail < max_len ? avail : max_len;
+    const char* eol = {0};
 
-    if ((eol = strchr(buffer, '\n')) == NULL) {
-        eol = strchr(buffer, '\r');
+    if ((eol = memchr(start, '\n', len)) == NULL) {
+        eol = memchr(start, '\r', len);
     }
 
     if (eol != NULL) {
-        *++eol = '\0';
-        bytes_read = eol - buffer;
+        len = eol - start + 1;
     }
 
-    nxfile->offset += bytes_read;
+    memcpy(buffer, start, len);
+    buffer[len] = '\0';
+    nxfile->offset += len;
     return true;
 }
 
 bool ini_write(const char* buffer, struct NxFile* nxfile) {
     const size_t size = strlen(buffer);
+    block_drop(nxfile);
     if (R_FAILED(fsFileWrite(&nxfile->file, nxfile->offset, buffer, size, FsWriteOption_None))) {
         return false;
     }
@@ -96,32 +186,34 @@ bool ini_seek(struct NxFile* nxfile, s64* pos) {
 
 bool ini_rename(const char* src, const char* dst) {
     Result rc = {0};
-    FsFileSystem fs = {0};
+    FsFileSystem own_fs = {0};
+    FsFileSystem* fs = {0};
     char src_buf[FS_MAX_PATH] = {0};
     char dst_buf[FS_MAX_PATH] = {0};
 
-    if (R_FAILED(rc = fsOpenSdCardFileSystem(&fs))) {
+    if ((fs = ini_fs_open(&own_fs)) == NULL) {
         return false;
     }
 
     strcpy(src_buf, src);
     strcpy(dst_buf, dst);
-    rc = fsFsRenameFile(&fs, src_buf, dst_buf);
-    fsFsClose(&fs);
+    rc = fsFsRenameFile(fs, src_buf, dst_buf);
+    ini_fs_close(fs);
     return R_SUCCEEDED(rc);
 }
 
 bool ini_remove(const char* filename) {
     Result rc = {0};
-    FsFileSystem fs = {0};
+    FsFileSystem own_fs = {0};
+    FsFileSystem* fs = {0};
     char filename_buf[FS_MAX_PATH] = {0};
 
-    if (R_FAILED(rc = fsOpenSdCardFileSystem(&fs))) {
+    if ((fs = ini_fs_open(&own_fs)) == NULL) {
         return false;
     }
 
     strcpy(filename_buf, filename);
-    rc = fsFsDeleteFile(&fs, filename_buf);
-    fsFsClose(&fs);
+    rc = fsFsDeleteFile(fs, filename_buf);
+    ini_fs_close(fs);
     return R_SUCCEEDED(rc);
 }
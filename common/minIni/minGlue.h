@@ -8,7 +8,8 @@ extern "C" {
 
 struct NxFile {
     FsFile file;
-    FsFileSystem system;
+    FsFileSystem system; // if there's no shared session
+    FsFileSystem* fs; // the session the file was opened with
     s64 offset;
 };
 
@@ -17,6 +18,14 @@ struct NxFile {
 #define INI_OPENREWRITE
 #define INI_REMOVE
 
+// a session of the sd card shared by every file operation, instead of one per operation.
+// opened once at startup with ini_fs_init() and closed with ini_fs_exit()
+bool ini_fs_init(void);
+void ini_fs_exit(void);
+// the shared session, or a new one in fs if there's none. to be closed with ini_fs_close()
+FsFileSystem* ini_fs_open(FsFileSystem* fs);
+void ini_fs_close(FsFileSystem* fs);
+
 bool ini_openread(const char* filename, struct NxFile* nxfile);
 bool ini_openwrite(const char* filename, struct NxFile* nxfile);
 bool ini_openrewrite(const char* filename, struct NxFile* nxfile);
@@ -0,0 +1,183 @@
+#pragma once
+
+// the overlay's queue of config changes, kept apart from main.cpp so that it can be checked on
+// the host against the posix stand-in for libnx (see sysmod/bench/ini_bench.cpp)
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include "minIni/minIni.h"
+#include "ini_table.hpp"
+
+namespace {
+
+// changes to the config are kept in memory, and written out together by a background thread
+// once nothing changed for a moment, or when the overlay hides. so the ui doesn't wait for the
+// sd card, and toggling quickly costs one write rather than a rewrite of the file per toggle.
+// minGlue only has one read block, so files are used by one thread at a time, see with_files()
+class ConfigQueue {
+public:
+    static constexpr u32 MAX_ENTRIES = 16;
+    static constexpr auto FLUSH_DELAY = std::chrono::milliseconds{500}; // after the last change
+
+    explicit ConfigQueue(const char* _path) : path{_path} {}
+
+    void start() {
+        running = true;
+        if (R_FAILED(threadCreate(&thread, thread_func, this, nullptr, 0x4000, 0x2c, -2))) {
+            return;
+        }
+        if (R_FAILED(threadStart(&thread))) {
+            threadClose(&thread);
+            return;
+        }
+        started = true;
+    }
+
+    // writes out whatever is left
+    void stop() {
+        {
+            std::scoped_lock lock{mutex};
+            running = false;
+        }
+        cv.notify_one();
+
+        if (started) {
+            threadWaitForExit(&thread);
+            threadClose(&thread);
+            started = false;
+        }
+        flush();
+    }
+
+    // the value that was set last, or the one in the file
+    auto get(const char* section, const char* key, bool _default) -> bool {
+        {
+            std::scoped_lock lock{mutex};
+            if (const auto e = find(section, key)) {
+                return e->value;
+            }
+        }
+        return with_files([&]{ return ini_getbool(section, key, _default, path) != 0; });
+    }
+
+    void set(const char* section, const char* key, bool value) {
+        std::unique_lock lock{mutex};
+        auto e = find(section, key);
+        if (!e) {
+            if (count == MAX_ENTRIES) {
+                // only happens if there are more toggles than entries
+                lock.unlock();
+                with_files([&]{ ini_putl(section, key, value, path); });
+                return;
+            }
+            e = &entries[count++];
+            e->section = section;
+            e->key = key;
+        }
+
+        e->value = value;
+        e->pending = true;
+        pending = true;
+        changes++;
+        lock.unlock();
+        cv.notify_one();
+
+        // without the thread, the change is written out right away
+        if (!started) {
+            flush();
+        }
+    }
+
+    // writes out the pending changes in one go
+    void flush() {
+        std::scoped_lock files_lock{files_mutex};
+        Entry changed[MAX_ENTRIES];
+        u32 changed_count{};
+
+        {
+            std::scoped_lock lock{mutex};
+            for (auto& e : std::span{entries, count}) {
+                if (e.pending) {
+                    changed[changed_count++] = e;
+                    e.pending = false;
+                }
+            }
+            pending = false;
+        }
+
+        if (!changed_count) {
+            return;
+        }
+
+        config.load(path);
+        for (const auto& e : std::span{changed, changed_count}) {
+            config.set(e.section, e.key, e.value);
+        }
+        config.save(path);
+    }
+
+    template<typename F>
+    auto with_files(F&& fn) -> decltype(fn()) {
+        std::scoped_lock lock{files_mutex};
+        return fn();
+    }
+
+private:
+    struct Entry {
+        const char* section;
+        const char* key;
+        bool value;
+        bool pending; // not written out yet
+    };
+
+    const char* path;
+    Entry entries[MAX_ENTRIES]{};
+    u32 count{};
+    bool pending{};
+    u32 changes{}; // bumped by every set()
+    bool running{};
+    bool started{};
+    std::mutex mutex; // of the entries and the flags above
+    std::mutex files_mutex;
+    std::condition_variable cv;
+    Thread thread{};
+    inline static IniTable config; // too big for the stack of the thread
+
+    auto find(const char* section, const char* key) -> Entry* {
+        for (auto& e : std::span{entries, count}) {
+            if (!strcmp(e.section, section) && !strcmp(e.key, key)) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    static void thread_func(void* arg) {
+        static_cast<ConfigQueue*>(arg)->run();
+    }
+
+    void run() {
+        std::unique_lock lock{mutex};
+        while (running) {
+            if (!pending) {
+                cv.wait(lock);
+                continue;
+            }
+
+            // wait until nothing changed for a while
+            const auto last_changes = changes;
+            if (cv.wait_for(lock, FLUSH_DELAY, [&]{ return !running || changes != last_changes; })) {
+                continue;
+            }
+
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+};
+
+} // namespace
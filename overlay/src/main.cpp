@@ -4,6 +4,7 @@
 #include <string_view>
 #include <span>
 #include "minIni/minIni.h"
+#include "config_queue.hpp"
 
 namespace {
 
@@ -12,37 +13,41 @@ constexpr auto LOG_PATH = "/config/sys-dock/log.ini";
 
 auto does_file_exist(const char* path) -> bool {
     Result rc{};
-    FsFileSystem fs{};
+    FsFileSystem own_fs{};
     FsFile file{};
     char path_buf[FS_MAX_PATH]{};
 
-    if (R_FAILED(fsOpenSdCardFileSystem(&fs))) {
+    const auto fs = ini_fs_open(&own_fs);
+    if (!fs) {
         return false;
     }
 
     strcpy(path_buf, path);
-    rc = fsFsOpenFile(&fs, path_buf, FsOpenMode_Read, &file);
+    rc = fsFsOpenFile(fs, path_buf, FsOpenMode_Read, &file);
     fsFileClose(&file);
-    fsFsClose(&fs);
+    ini_fs_close(fs);
     return R_SUCCEEDED(rc);
 }
 
 // creates a directory, non-recursive!
 auto create_dir(const char* path) -> bool {
     Result rc{};
-    FsFileSystem fs{};
+    FsFileSystem own_fs{};
     char path_buf[FS_MAX_PATH]{};
 
-    if (R_FAILED(fsOpenSdCardFileSystem(&fs))) {
+    const auto fs = ini_fs_open(&own_fs);
+    if (!fs) {
         return false;
     }
 
     strcpy(path_buf, path);
-    rc = fsFsCreateDirectory(&fs, path_buf);
-    fsFsClose(&fs);
+    rc = fsFsCreateDirectory(fs, path_buf);
+    ini_fs_close(fs);
     return R_SUCCEEDED(rc);
 }
 
+ConfigQueue config_queue{CONFIG_PATH};
+
 struct ConfigEntry {
     ConfigEntry(const char* _section, const char* _key, bool default_value, s32 _group = -1) :
         section{_section}, key{_key}, value{default_value}, mutual_exclusivity_group{_group} {
@@ -50,14 +55,14 @@ struct ConfigEntry {
         }
 
     void load_value_from_ini() {
-        this->value = ini_getbool(this->section, this->key, this->value, CONFIG_PATH);
+        this->value = config_queue.get(this->section, this->key, this->value);
     }
 
     auto create_list_item(const char* text) {
         auto item = new tsl::elm::ToggleListItem(text, value);
         item->setStateChangedListener([this](bool new_value){
             this->value = new_value;
-            ini_putl(this->section, this->key, this->value, CONFIG_PATH);
+            config_queue.set(this->section, this->key, this->value);
         });
         return item;
     }
@@ -81,6 +86,7 @@ public:
         list->addItem(config_patch_emummc.create_list_item("Patch emuMMC"));
         list->addItem(config_logging.create_list_item("Logging"));
         list->addItem(config_version_skip.create_list_item("Version skip"));
+        list->addItem(config_parallel.create_list_item("Parallel"));
 
         frame->setContent(list);
         return frame;
@@ -90,6 +96,7 @@ public:
     ConfigEntry config_patch_emummc{"options", "patch_emummc", true};
     ConfigEntry config_logging{"options", "enable_logging", true};
     ConfigEntry config_version_skip{"options", "version_skip", true};
+    ConfigEntry config_parallel{"options", "parallel", false};
 };
 
 class GuiToggle final : public tsl::Gui {
@@ -110,13 +117,13 @@ public:
                 t.item = new tsl::elm::ToggleListItem(t.config.key, t.config.value);
                 t.item->setStateChangedListener([&t, toggles](bool new_value){
                     t.config.value = new_value;
-                    ini_putl(t.config.section, t.config.key, new_value, CONFIG_PATH);
+                    config_queue.set(t.config.section, t.config.key, new_value);
                     if (new_value && t.config.mutual_exclusivity_group >= 0) {
                         for (auto& other : toggles) {
                             if (&other != &t &&
                                 other.config.mutual_exclusivity_group == t.config.mutual_exclusivity_group) {
                                 other.config.value = false;
-                                ini_putl(other.config.section, other.config.key, false, CONFIG_PATH);
+                                config_queue.set(other.config.section, other.config.key, false);
                                 other.item->setState(false);
                             }
                         }
@@ -157,13 +164,14 @@ public:
         auto frame = new tsl::elm::OverlayFrame("sys-dock", VERSION_WITH_HASH);
         auto list = new tsl::elm::List();
 
-        if (does_file_exist(LOG_PATH)) {
+        // not while the config is written out, see ConfigQueue
+        if (config_queue.with_files([]{ return does_file_exist(LOG_PATH); })) {
             struct CallbackUser {
                 tsl::elm::List* list;
                 std::string last_section;
             } callback_userdata{list};
 
-            ini_browse([](const mTCHAR *Section, const mTCHAR *Key, const mTCHAR *Value, void *UserData){
+            const auto callback = [](const mTCHAR *Section, const mTCHAR *Key, const mTCHAR *Value, void *UserData){
                 auto user = (CallbackUser*)UserData;
                 std::string_view value{Value};
 
@@ -197,7 +205,9 @@ public:
                 }
 
                 return 1;
-            }, &callback_userdata, LOG_PATH);
+            };
+
+            config_queue.with_files([&]{ return ini_browse(callback, &callback_userdata, LOG_PATH); });
         } else {
             list->addItem(new tsl::elm::ListItem("No log found!"));
         }
@@ -256,6 +266,24 @@ public:
 // libtesla already initialized fs, hid, pl, pmdmnt, hid:sys and set:sys
 class SysDockOverlay final : public tsl::Overlay {
 public:
+    // one session of the sd card for every file, each file opens its own if this fails
+    void initServices() override {
+        ini_fs_init();
+        create_dir("/config/");
+        create_dir("/config/sys-dock/");
+        config_queue.start();
+    }
+
+    void exitServices() override {
+        config_queue.stop();
+        ini_fs_exit();
+    }
+
+    // so that nothing is lost if the overlay is closed while hidden
+    void onHide() override {
+        config_queue.flush();
+    }
+
     std::unique_ptr<tsl::Gui> loadInitialGui() override {
         return initially<GuiMain>();
     }
@@ -264,7 +292,5 @@ public:
 } // namespace
 
 int main(int argc, char **argv) {
-    create_dir("/config/");
-    create_dir("/config/sys-dock/");
     return tsl::loop<SysDockOverlay>(argc, argv);
 }
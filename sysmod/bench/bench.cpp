@@ -0,0 +1,829 @@
+// host benchmark for the pattern scanner in ../src/scanner.hpp.
+// runs over synthetic AArch64 images and checks that every engine reports the
+// same hits as the original per-pattern loop from patcher().
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "scanner.hpp"
+#include "patterns.hpp"
+
+namespace {
+
+// same as main.cpp
+constexpr u64 READ_BUFFER_SIZE = 0x8000;
+constexpr u64 MIN_READ_SIZE = 0x1000;
+
+constexpr size_t PATTERN_COUNT = std::size(nvservices_patterns) + std::size(usb_patterns);
+
+// byte pattern i of the pattern tables in patterns.hpp, nvservices then usb
+constexpr auto table_pattern(size_t i) -> const PatternData& {
+    return i < std::size(nvservices_patterns) ? nvservices_patterns[i].byte_pattern : usb_patterns[i - std::size(nvservices_patterns)].byte_pattern;
+}
+
+struct Rng {
+    u64 state{0x9E3779B97F4A7C15};
+
+    auto next() -> u64 {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+// random instructions, with the top byte weighted towards common AArch64 opcodes
+auto make_image(size_t size, Rng& rng) -> std::vector<u8> {
+    constexpr u8 common_ops[] = {
+        0xF9, 0xB9, 0x39, 0x91, 0xAA, 0x2A, 0x52, 0x72, 0x54, 0x94, 0x97, 0x34, 0x35, 0x36, 0x37,
+        0xD1, 0xF1, 0x71, 0x6B, 0xEB, 0xA9, 0xA8, 0x12, 0x0A, 0x8B, 0x0B, 0x1A, 0x9A, 0x17, 0xD6,
+    };
+
+    std::vector<u8> image(size);
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        auto inst = static_cast<u32>(rng.next());
+        if (rng.next() % 8) {
+            inst = (inst & 0x00FFFFFF) | (u32(common_ops[rng.next() % std::size(common_ops)]) << 24);
+        }
+        std::memcpy(image.data() + i, &inst, sizeof(inst));
+    }
+    return image;
+}
+
+// writes the pattern into the image, filling wildcards with random bits
+void plant(std::vector<u8>& image, size_t offset, const PatternData& p, Rng& rng) {
+    for (u32 i = 0; i < p.words; i++) {
+        const auto inst = (p.value[i] & p.mask[i]) | (u32(rng.next()) & ~p.mask[i]);
+        std::memcpy(image.data() + offset + i * 4, &inst, sizeof(inst));
+    }
+}
+
+// byte by byte form of a pattern, as the original loop compared it
+struct RefPattern {
+    RefPattern(const PatternData& p) : size{p.size} {
+        for (u32 i = 0; i < p.size; i++) {
+            value[i] = p.value[i / 4] >> (i % 4 * 8);
+            mask[i] = p.mask[i / 4] >> (i % 4 * 8);
+        }
+    }
+
+    u8 value[60]{};
+    u8 mask[60]{};
+    u8 size{};
+};
+
+struct Hit {
+    u32 id;
+    u64 offset;
+
+    auto operator<=>(const Hit&) const = default;
+};
+
+// number of reads (svcReadDebugProcessMemory calls) done by the last scan
+u64 g_reads{};
+
+// reads the image the same way DebugReadSource in main.cpp does, with a memcpy in place of
+// svcReadDebugProcessMemory
+struct CopySource {
+    const std::vector<u8>& image;
+    u64 min_read_size{MIN_READ_SIZE};
+    u64 max_read_size{READ_BUFFER_SIZE};
+    u32 slot{};
+
+    auto size() const -> u64 { return image.size(); }
+    auto min_read() const -> u64 { return min_read_size; }
+    auto max_read() const -> u64 { return max_read_size; }
+
+    auto read(u64 offset, u64 size) -> const u8* {
+        static std::vector<u8> buffer[2];
+        buffer[slot].resize(max_read_size);
+        const auto data = buffer[slot].data();
+        std::memcpy(data, image.data() + offset, size);
+        g_reads++;
+        slot ^= 1;
+        return data;
+    }
+};
+
+// a file mapped into memory, the host version of MappedSource in main.cpp
+struct FileSource {
+    const u8* data{};
+    u64 file_size{};
+
+    auto map(const char* path) -> bool {
+        const auto fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            const auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const u8*>(p);
+                file_size = st.st_size;
+            }
+        }
+        close(fd);
+        return data;
+    }
+
+    void unmap() {
+        munmap(const_cast<u8*>(data), file_size);
+    }
+
+    auto size() const -> u64 { return file_size; }
+    auto min_read() const -> u64 { return file_size; }
+    auto max_read() const -> u64 { return file_size; }
+
+    auto read(u64 offset, u64) -> const u8* {
+        g_reads++;
+        return data + offset;
+    }
+};
+
+// number of full pattern compares started by the last scan
+u64 g_candidates{};
+
+// the original loop from patcher(), one sweep of the image per pattern
+auto scan_reference(const std::vector<u8>& image, const std::vector<PatternData>& patterns) -> std::vector<Hit> {
+    g_candidates = 0;
+    std::vector<Hit> hits;
+
+    const auto data = image.data();
+    const auto data_size = image.size();
+    for (u32 id = 0; id < patterns.size(); id++) {
+        const RefPattern p{patterns[id]};
+
+        for (u32 i = 0; i + p.size <= data_size; i++) {
+            g_candidates++;
+            u32 count{};
+            while (count < p.size) {
+                if ((data[i + count] & p.mask[count]) != p.value[count]) {
+                    break;
+                }
+                count++;
+            }
+
+            if (count == p.size) {
+                hits.push_back({ id, i });
+                break;
+            }
+        }
+    }
+
+    return hits;
+}
+
+template<bool UseSimd = MultiScanner::HAS_SIMD>
+auto scan_multi(const std::vector<u8>& image, const std::vector<PatternData>& patterns,
+    u64 min_read = MIN_READ_SIZE, u64 max_read = READ_BUFFER_SIZE) -> std::vector<Hit> {
+    std::vector<Hit> hits;
+    MultiScanner scanner;
+
+    for (u32 id = 0; id < patterns.size(); id++) {
+        scanner.add(patterns[id], id);
+    }
+
+    g_reads = 0;
+    CopySource source{image, min_read, max_read};
+    scanner.scan_source<UseSimd>(source, [&](u8 id, u64 offset, const u8*) {
+        hits.push_back({ id, offset });
+        return true;
+    });
+
+    g_candidates = scanner.candidates;
+    return hits;
+}
+
+// best of runs
+template<typename F>
+auto time_ms(F&& fn, std::vector<Hit>& hits, int runs = 3) -> double {
+    double best{1e30};
+    for (int run = 0; run < runs; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        hits = fn();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(hits.begin(), hits.end());
+    return best;
+}
+
+void check(const char* name, const std::vector<Hit>& expected, const std::vector<Hit>& got) {
+    if (expected != got) {
+        std::fprintf(stderr, "%s: hits differ from the reference loop (%zu vs %zu)\n", name, got.size(), expected.size());
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+// the real patterns plus made up firmware variants of them (last instruction changed)
+auto make_patterns(size_t count) -> std::vector<PatternData> {
+    std::vector<PatternData> patterns;
+    for (size_t i = 0; patterns.size() < count; i++) {
+        PatternData p = table_pattern(i % PATTERN_COUNT);
+        if (i >= PATTERN_COUNT) {
+            p.value[p.words - 1] ^= (u32(i) * 0x01010101U) & p.mask[p.words - 1];
+        }
+        patterns.push_back(p);
+    }
+    return patterns;
+}
+
+// a synthetic image and patterns, with the first PATTERN_COUNT of them planted 0x400 apart
+struct Fixture {
+    std::vector<u8> image;
+    std::vector<PatternData> patterns;
+    std::vector<u64> offsets; // of the planted patterns
+};
+
+// position is where the planted patterns start, as part of the image. by default they're
+// towards the end, so that most of the image gets scanned
+auto make_fixture(size_t size, size_t pattern_count = PATTERN_COUNT, double position = 0.875) -> Fixture {
+    Rng rng{};
+    Fixture f{ make_image(size, rng), make_patterns(pattern_count), {} };
+    for (size_t i = 0; i < PATTERN_COUNT; i++) {
+        f.offsets.push_back(size_t(size * position) / 4 * 4 + i * 0x400);
+        plant(f.image, f.offsets.back(), f.patterns[i], rng);
+    }
+    return f;
+}
+
+void bench_multi_pattern() {
+    std::printf("== multi-pattern scan: reference loop vs MultiScanner ==\n");
+    std::printf("%8s %8s %14s %14s %8s\n", "image", "patterns", "reference ms", "multi ms", "speedup");
+
+    for (const size_t size : { 2u << 20, 8u << 20 }) {
+        for (const size_t count : { PATTERN_COUNT, size_t{32} }) {
+            const auto [image, patterns, offsets] = make_fixture(size, count);
+
+            std::vector<Hit> expected, got;
+            const auto ref_ms = time_ms([&] { return scan_reference(image, patterns); }, expected);
+            const auto multi_ms = time_ms([&] { return scan_multi(image, patterns); }, got);
+            check("MultiScanner", expected, got);
+
+            std::printf("%6zuMB %8zu %14.2f %14.2f %7.1fx\n", size >> 20, count, ref_ms, multi_ms, ref_ms / multi_ms);
+        }
+    }
+}
+
+void bench_anchor() {
+    std::printf("== anchor prefilter: candidates and time over 8MB, %zu patterns ==\n", PATTERN_COUNT);
+    std::printf("%-24s %14s %12s\n", "engine", "candidates", "ms");
+
+    constexpr size_t size = 8u << 20;
+    const auto [image, patterns, offsets] = make_fixture(size);
+
+    std::vector<Hit> expected, got;
+    auto ms = time_ms([&] { return scan_reference(image, patterns); }, expected);
+    std::printf("%-24s %14llu %12.2f\n", "reference loop", (unsigned long long)g_candidates, ms);
+
+    ms = time_ms([&] { return scan_multi<false>(image, patterns); }, got);
+    check("anchor (scalar)", expected, got);
+    std::printf("%-24s %14llu %12.2f\n", "anchor (scalar)", (unsigned long long)g_candidates, ms);
+
+    if constexpr (MultiScanner::HAS_SIMD) {
+        ms = time_ms([&] { return scan_multi<true>(image, patterns); }, got);
+        check("anchor (simd)", expected, got);
+        std::printf("%-24s %14llu %12.2f\n", "anchor (simd)", (unsigned long long)g_candidates, ms);
+    }
+}
+
+void bench_read_window() {
+    // assumed cost of one svcReadDebugProcessMemory round trip, this isn't measured here
+    constexpr double SVC_COST_US[] = { 2.0, 10.0 };
+    constexpr size_t size = 4u << 20;
+
+    std::printf("== read window: 4MB, modeled total = copy + scan + reads * svc cost ==\n");
+    std::printf("%-6s %-16s %8s %10s %14s %14s\n", "hits", "window", "reads", "ms", "total@2us", "total@10us");
+
+    struct Window {
+        const char* name;
+        u64 min_read;
+        u64 max_read;
+    };
+
+    constexpr Window windows[] = {
+        { "0x1000 (old)", 0x1000, 0x1000 },
+        { "0x4000", 0x4000, 0x4000 },
+        { "0x10000", 0x10000, 0x10000 },
+        { "0x40000", 0x40000, 0x40000 },
+        { "0x1000..0x8000", MIN_READ_SIZE, READ_BUFFER_SIZE },
+    };
+
+    for (const auto position : { 0.05, 0.9 }) {
+        const auto [image, patterns, offsets] = make_fixture(size, PATTERN_COUNT, position);
+
+        std::vector<Hit> expected;
+        time_ms([&] { return scan_reference(image, patterns); }, expected);
+
+        for (const auto& w : windows) {
+            std::vector<Hit> got;
+            const auto ms = time_ms([&] { return scan_multi(image, patterns, w.min_read, w.max_read); }, got);
+            check(w.name, expected, got);
+            std::printf("%-6s %-16s %8llu %10.2f %14.2f %14.2f\n", position < 0.5 ? "early" : "late", w.name,
+                (unsigned long long)g_reads, ms, ms + g_reads * SVC_COST_US[0] / 1000.0, ms + g_reads * SVC_COST_US[1] / 1000.0);
+        }
+    }
+}
+
+// scans the image in pieces of piece_size without copying it, so crossing patterns
+// are next to each other in memory
+auto scan_in_place(const std::vector<u8>& image, const std::vector<PatternData>& patterns, u64 piece_size) -> std::vector<Hit> {
+    std::vector<Hit> hits;
+    MultiScanner scanner;
+    for (u32 id = 0; id < patterns.size(); id++) {
+        scanner.add(patterns[id], id);
+    }
+
+    scanner.reset_stream();
+    for (u64 sz = 0; sz < image.size() && !scanner.done(); sz += piece_size) {
+        scanner.scan(image.data() + sz, std::min<u64>(piece_size, image.size() - sz), [&](u8 id, u64 offset, const u8*) {
+            hits.push_back({ id, offset });
+            return true;
+        });
+    }
+    return hits;
+}
+
+// every pattern planted so that it crosses a read at every possible word, with both the
+// separate ring buffers and pieces that are next to each other in memory
+void check_straddle() {
+    constexpr size_t size = 0x10000;
+    // first boundary after the growing reads of 0x1000 and 0x2000
+    constexpr size_t boundary = 0x3000;
+
+    u32 runs{};
+    for (size_t i = 0; i < PATTERN_COUNT; i++) {
+        const std::vector<PatternData> patterns{ table_pattern(i) };
+        const auto words = patterns[0].words;
+
+        for (u32 k = 1; k < words; k++) {
+            Rng rng{0x9E3779B97F4A7C15 ^ (i * 64 + k)};
+            auto image = make_image(size, rng);
+            plant(image, boundary - k * 4, patterns[0], rng);
+
+            std::vector<Hit> expected, got;
+            time_ms([&] { return scan_reference(image, patterns); }, expected);
+            if (expected.empty() || expected[0].offset > boundary - k * 4) {
+                std::fprintf(stderr, "straddle: planted pattern %zu not found by the reference loop\n", i);
+                std::exit(EXIT_FAILURE);
+            }
+
+            time_ms([&] { return scan_multi(image, patterns); }, got);
+            check("straddle (ring)", expected, got);
+            time_ms([&] { return scan_multi(image, patterns, 0x1000, 0x1000); }, got);
+            check("straddle (ring, 0x1000)", expected, got);
+            time_ms([&] { return scan_in_place(image, patterns, boundary); }, got);
+            check("straddle (in place)", expected, got);
+            runs++;
+        }
+    }
+    std::printf("== straddle: %u crossing placements found by every reader ==\n", runs);
+}
+
+// bytes copied and cleared by the last scan_copy(), on top of the reads
+u64 g_copied{};
+u64 g_cleared{};
+
+// the reads before the ring buffer: the last bytes of the previous read are copied in
+// front of the next one, and the rest of the buffer is cleared between reads
+auto scan_copy(const std::vector<u8>& image, const std::vector<PatternData>& patterns, u64 read_size) -> std::vector<Hit> {
+    constexpr u64 overlap = MAX_PATTERN_SIZE - 4;
+    static std::vector<u8> buffer;
+    buffer.assign(overlap + read_size, 0);
+
+    std::vector<Hit> hits;
+    MultiScanner scanner;
+    for (u32 id = 0; id < patterns.size(); id++) {
+        scanner.add(patterns[id], id);
+    }
+
+    g_copied = g_cleared = 0;
+    for (u64 sz = 0; sz < image.size() && !scanner.done(); sz += read_size) {
+        const auto actual_size = std::min<u64>(read_size, image.size() - sz);
+        std::memcpy(buffer.data() + overlap, image.data() + sz, actual_size);
+
+        // every read is scanned on its own, together with the copied bytes of the previous one
+        const auto base = sz - std::min(sz, overlap);
+        const auto data = buffer.data() + overlap - (sz - base);
+        scanner.reset_stream();
+        scanner.scan(data, actual_size + (sz - base), [&](u8 id, u64 offset, const u8*) {
+            hits.push_back({ id, base + offset });
+            return true;
+        });
+
+        std::memcpy(buffer.data(), buffer.data() + actual_size, overlap);
+        std::memset(buffer.data() + overlap, 0, read_size);
+        g_copied += overlap;
+        g_cleared += read_size;
+    }
+    return hits;
+}
+
+// what the ring saves is the copy of the overlap and the clear of the buffer on every read,
+// which is small next to the scan itself. the times are the best of many runs, as the
+// difference is within the noise of a few
+void bench_stream() {
+    constexpr size_t size = 8u << 20;
+    constexpr int runs = 20;
+    std::printf("== read buffer: copy + clear vs ring, 8MB, %zu patterns, best of %d ==\n", PATTERN_COUNT, runs);
+    std::printf("%-8s %12s %12s %14s %14s %8s\n", "read", "copied KB", "cleared KB", "copy ms", "ring ms", "speedup");
+
+    const auto [image, patterns, offsets] = make_fixture(size);
+
+    std::vector<Hit> expected;
+    time_ms([&] { return scan_reference(image, patterns); }, expected);
+
+    for (const u64 read_size : { 0x1000u, 0x8000u }) {
+        std::vector<Hit> got;
+        const auto copy_ms = time_ms([&] { return scan_copy(image, patterns, read_size); }, got, runs);
+        check("copy", expected, got);
+        const auto ring_ms = time_ms([&] { return scan_multi(image, patterns, read_size, read_size); }, got, runs);
+        check("ring", expected, got);
+        std::printf("%#-8llx %12llu %12llu %14.2f %14.2f %7.2fx\n", (unsigned long long)read_size,
+            (unsigned long long)g_copied >> 10, (unsigned long long)g_cleared >> 10, copy_ms, ring_ms, copy_ms / ring_ms);
+    }
+}
+
+void bench_crc() {
+    constexpr size_t size = 8u << 20;
+    std::printf("== fingerprint: crc32c vs full scan, 8MB, %zu patterns ==\n", PATTERN_COUNT);
+    std::printf("%-24s %10s %10s\n", "engine", "ms", "MB/s");
+
+    Rng rng{};
+    const auto image = make_image(size, rng);
+    // nothing planted, so the scan has to go through the whole image
+    const auto patterns = make_patterns(PATTERN_COUNT);
+
+    const auto print = [](const char* name, double ms) {
+        std::printf("%-24s %10.2f %10.0f\n", name, ms, (size >> 20) / (ms / 1000.0));
+    };
+
+    std::vector<Hit> hits;
+    u32 crc_sw{}, crc_hw{};
+    print("crc32c (table)", time_ms([&] { crc_sw = crc32c<false>(0, image.data(), image.size()); return std::vector<Hit>{}; }, hits));
+    if constexpr (HAS_HW_CRC32C) {
+        print("crc32c (hw)", time_ms([&] { crc_hw = crc32c<true>(0, image.data(), image.size()); return std::vector<Hit>{}; }, hits));
+        if (crc_sw != crc_hw) {
+            std::fprintf(stderr, "crc32c: hw and table differ (%08x vs %08x)\n", crc_hw, crc_sw);
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    print("scan (ring)", time_ms([&] { return scan_multi(image, patterns); }, hits));
+    std::printf("fingerprint %08x\n", crc_sw);
+
+    // check value of crc32c("123456789")
+    if (crc32c(0, "123456789", 9) != 0xE3069283) {
+        std::fprintf(stderr, "crc32c: wrong check value\n");
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+// the table the dispatch bench calls through, not constant so that every call goes through the pointers
+const Patterns* g_nvservices_patterns = nvservices_patterns;
+
+// apply_match() as it was before PatternTable, calling cond, patch and applied through the
+// pointers of the table's row
+auto apply_match_pointers(PatchBatch& batch, const Patterns* table, u8 id, u64 addr, const u8* match) -> bool {
+    const auto& p = table[id];
+
+    u32 inst{};
+    std::memcpy(&inst, match + p.inst_offset, sizeof(inst));
+
+    if (p.cond(inst)) {
+        const auto patch_data = p.patch(inst);
+
+        auto& w = batch.writes[batch.count++];
+        w.addr = addr + p.inst_offset + p.patch_offset;
+        w.size = patch_data.size;
+        w.patterns = 1U << id;
+        std::memcpy(w.data, patch_data.data, patch_data.size);
+        std::memcpy(w.original, match + p.inst_offset + p.patch_offset, patch_data.size);
+        return true;
+    }
+    return p.applied(match + p.inst_offset + p.patch_offset, inst);
+}
+
+// the same candidates through apply_match_pointers() and through PatternTable::apply_match()
+// of the sysmodule, the sum of the results and patch sizes has to be the same
+void bench_dispatch() {
+    constexpr size_t count = 1u << 22;
+    using Table = PatternTable<nvservices_patterns>;
+    std::printf("== pattern actions: function pointers vs template dispatch, %zu candidates ==\n", count);
+    std::printf("%-24s %10s %14s\n", "dispatch", "ms", "ns/candidate");
+
+    Rng rng{};
+    const auto image = make_image(1u << 20, rng);
+    struct Candidate {
+        u8 id;
+        u32 offset;
+    };
+    std::vector<Candidate> candidates(count);
+    for (auto& c : candidates) {
+        c.id = rng.next() % Table::size;
+        c.offset = (&c - candidates.data()) * 4 % (image.size() - MAX_PATTERN_SIZE);
+    }
+
+    static PatchBatch batch;
+    const auto result = [&](bool resolved) -> u64 {
+        const u64 size = batch.count ? batch.writes[0].size : 0;
+        batch.count = 0;
+        return resolved + size;
+    };
+
+    u64 sum_pointer{}, sum_template{};
+    std::vector<Hit> hits;
+    const auto pointer_ms = time_ms([&] {
+        sum_pointer = 0;
+        for (const auto& c : candidates) {
+            sum_pointer += result(apply_match_pointers(batch, g_nvservices_patterns, c.id, c.offset, image.data() + c.offset));
+        }
+        return std::vector<Hit>{};
+    }, hits);
+
+    const auto template_ms = time_ms([&] {
+        sum_template = 0;
+        for (const auto& c : candidates) {
+            sum_template += result(Table::apply_match(batch, c.id, c.offset, image.data() + c.offset));
+        }
+        return std::vector<Hit>{};
+    }, hits);
+
+    if (sum_pointer != sum_template) {
+        std::fprintf(stderr, "dispatch: results differ (%llu vs %llu)\n", (unsigned long long)sum_template, (unsigned long long)sum_pointer);
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::printf("%-24s %10.2f %14.2f\n", "function pointers", pointer_ms, pointer_ms * 1e6 / count);
+    std::printf("%-24s %10.2f %14.2f\n", "template", template_ms, template_ms * 1e6 / count);
+}
+
+// scans a file in place through mmap against copying it out in reads.
+// path is a dump of a title's code, otherwise a synthetic image is written to a temporary file
+void bench_source(const char* path) {
+    std::printf("== memory source: copied reads vs mapped file, %zu patterns ==\n", PATTERN_COUNT);
+
+    char tmp_path[] = "/tmp/sys-dock-bench-XXXXXX";
+    if (!path) {
+        const auto image = make_fixture(8u << 20).image;
+        const auto fd = mkstemp(tmp_path);
+        if (fd < 0 || write(fd, image.data(), image.size()) != ssize_t(image.size())) {
+            std::fprintf(stderr, "source: couldn't write %s\n", tmp_path);
+            std::exit(EXIT_FAILURE);
+        }
+        close(fd);
+        path = tmp_path;
+    }
+
+    FileSource file{};
+    if (!file.map(path)) {
+        std::fprintf(stderr, "source: couldn't map %s\n", path);
+        std::exit(EXIT_FAILURE);
+    }
+
+    // the scanner works on whole instructions
+    const std::vector<u8> image(file.data, file.data + file.size() / 4 * 4);
+    const auto patterns = make_patterns(PATTERN_COUNT);
+    std::printf("%s, %lluKB\n", path == tmp_path ? "synthetic image" : path, (unsigned long long)image.size() >> 10);
+    std::printf("%-24s %8s %10s %6s\n", "source", "reads", "ms", "hits");
+
+    std::vector<Hit> expected, got;
+    time_ms([&] { return scan_reference(image, patterns); }, expected);
+
+    auto ms = time_ms([&] { return scan_multi(image, patterns); }, got);
+    check("copied reads", expected, got);
+    std::printf("%-24s %8llu %10.2f %6zu\n", "copied reads", (unsigned long long)g_reads, ms, got.size());
+
+    ms = time_ms([&] {
+        std::vector<Hit> hits;
+        MultiScanner scanner;
+        for (u32 id = 0; id < patterns.size(); id++) {
+            scanner.add(patterns[id], id);
+        }
+
+        g_reads = 0;
+        scanner.scan_source(file, [&](u8 id, u64 offset, const u8*) {
+            hits.push_back({ id, offset });
+            return true;
+        });
+        return hits;
+    }, got);
+    check("mapped file", expected, got);
+    std::printf("%-24s %8llu %10.2f %6zu\n", "mapped file", (unsigned long long)g_reads, ms, got.size());
+
+    file.unmap();
+    if (path == tmp_path) {
+        unlink(tmp_path);
+    }
+}
+
+// splits the image into ranges that are each scanned by a copy of the scanner, on their own
+// thread like patcher_parallel() in main.cpp, then keeps the first candidate of each pattern
+auto scan_split(const std::vector<u8>& image, const std::vector<PatternData>& patterns, u32 ranges) -> std::vector<Hit> {
+    MultiScanner scanner;
+    for (u32 id = 0; id < patterns.size(); id++) {
+        scanner.add(patterns[id], id);
+    }
+
+    const u64 range_size = (image.size() / ranges + 3) & ~3ULL;
+    std::vector<std::vector<u64>> first(ranges, std::vector<u64>(MultiScanner::MAX_PATTERNS, ~0ULL));
+    const auto run = [&](u32 i) {
+        const auto begin = std::min<u64>(i * range_size, image.size());
+        const auto end = i + 1 == ranges ? image.size() : std::min<u64>(begin + range_size, image.size());
+        auto copy = scanner;
+        copy.find_first(image.data(), image.size(), begin, end, first[i].data());
+    };
+
+    std::vector<std::thread> threads;
+    for (u32 i = 1; i < ranges; i++) {
+        threads.emplace_back(run, i);
+    }
+    run(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::vector<Hit> hits;
+    for (u32 id = 0; id < patterns.size(); id++) {
+        u64 offset = ~0ULL;
+        for (const auto& f : first) {
+            offset = std::min(offset, f[id]);
+        }
+        if (offset != ~0ULL) {
+            hits.push_back({ id, offset });
+        }
+    }
+    return hits;
+}
+
+// the patterns planted across every range boundary, then the time of the scan by thread count
+void bench_split() {
+    constexpr size_t size = 8u << 20;
+    std::printf("== split scan: ranges on their own threads, 8MB, %zu patterns ==\n", PATTERN_COUNT);
+
+    u32 runs{};
+    for (u32 ranges = 2; ranges <= 4; ranges++) {
+        for (size_t i = 0; i < PATTERN_COUNT; i++) {
+            const std::vector<PatternData> patterns{ table_pattern(i) };
+            for (u32 k = 0; k <= patterns[0].words; k++) {
+                Rng rng{0x9E3779B97F4A7C15 ^ (ranges * 4096 + i * 64 + k)};
+                auto image = make_image(0x10000 * ranges, rng);
+                const u64 boundary = (image.size() / ranges + 3) & ~3ULL;
+                plant(image, boundary - k * 4, patterns[0], rng);
+
+                std::vector<Hit> expected, got;
+                time_ms([&] { return scan_reference(image, patterns); }, expected);
+                time_ms([&] { return scan_split(image, patterns, ranges); }, got);
+                check("split (boundary)", expected, got);
+                runs++;
+            }
+        }
+    }
+    std::printf("%u placements around the range boundaries found\n", runs);
+
+    const auto [image, patterns, offsets] = make_fixture(size);
+
+    std::vector<Hit> expected;
+    time_ms([&] { return scan_reference(image, patterns); }, expected);
+
+    std::printf("%-8s %10s %8s\n", "threads", "ms", "speedup");
+    double single_ms{};
+    for (const u32 ranges : { 1u, 2u, 3u, 4u }) {
+        std::vector<Hit> got;
+        const auto ms = time_ms([&] { return scan_split(image, patterns, ranges); }, got);
+        check("split", expected, got);
+        if (ranges == 1) {
+            single_ms = ms;
+        }
+        std::printf("%-8u %10.2f %7.2fx\n", ranges, ms, single_ms / ms);
+    }
+}
+
+// compares per wrong candidate: the byte loop from patcher() at every offset, then the words
+// after an anchor hit left to right against PatternData::order.
+// path is a dump of a title's code, otherwise a synthetic image is used
+void bench_verify(const char* path) {
+    std::vector<u8> image;
+    if (path) {
+        FileSource file{};
+        if (!file.map(path)) {
+            std::fprintf(stderr, "verify: couldn't map %s\n", path);
+            std::exit(EXIT_FAILURE);
+        }
+        image.assign(file.data, file.data + file.size() / 4 * 4);
+        file.unmap();
+    }
+
+    const auto patterns = make_patterns(PATTERN_COUNT);
+    if (!path) {
+        // random code hardly ever has the rare anchors, so put them in 1000 times for each pattern,
+        // in front of and behind random instructions as in code that only shares the one instruction
+        Rng rng{};
+        image = make_image(8u << 20, rng);
+        for (const auto& p : patterns) {
+            for (u32 i = 0; i < 1000; i++) {
+                const auto inst = (p.value[p.anchor] & p.mask[p.anchor]) | (u32(rng.next()) & ~p.mask[p.anchor]);
+                std::memcpy(image.data() + (rng.next() % (image.size() / 4)) * 4, &inst, sizeof(inst));
+            }
+        }
+    }
+    std::printf("== verification order: compares per wrong candidate, %s, %zu patterns ==\n", path ? path : "synthetic image", patterns.size());
+    std::printf("%-24s %12s %12s %10s\n", "order", "candidates", "compares", "per wrong");
+
+    struct Stats {
+        u64 candidates;
+        u64 compares;
+        u64 wrong;
+        u64 wrong_compares;
+    };
+    Stats bytes{}, left_to_right{}, ordered{};
+
+    const auto data = image.data();
+    for (const auto& p : patterns) {
+        const RefPattern ref{p};
+        for (u64 i = 0; i + p.size <= image.size(); i++) {
+            u32 count{};
+            while (count < ref.size && (data[i + count] & ref.mask[count]) == ref.value[count]) {
+                count++;
+            }
+            bytes.candidates++;
+            bytes.compares += std::min<u32>(count + 1, ref.size);
+            if (count != ref.size) {
+                bytes.wrong++;
+                bytes.wrong_compares += count + 1;
+            }
+        }
+
+        // the candidates of the scanner, where the anchor matches
+        for (u64 start = 0; start + p.words * 4 <= image.size(); start += 4) {
+            const auto word = [&](u32 w) { return (load_inst(data + start + w * 4) & p.mask[w]) == p.value[w]; };
+            if (!word(p.anchor)) {
+                continue;
+            }
+
+            const auto run = [&](Stats& stats, auto&& next_word) {
+                u32 count{};
+                bool match = true;
+                for (u32 k = 0; match && next_word(k) < p.words; k++) {
+                    count++;
+                    match = word(next_word(k));
+                }
+                stats.candidates++;
+                stats.compares += count;
+                if (!match) {
+                    stats.wrong++;
+                    stats.wrong_compares += count;
+                }
+            };
+
+            // every word but the anchor, as the scanner used to compare them
+            run(left_to_right, [&](u32 k) -> u32 { return k + (k >= p.anchor); });
+            run(ordered, [&](u32 k) -> u32 { return k < p.order_count ? p.order[k] : p.words; });
+        }
+    }
+
+    // the scanner has to do exactly the compares of the ordered model
+    MultiScanner scanner;
+    for (u32 id = 0; id < patterns.size(); id++) {
+        scanner.add(patterns[id], id);
+    }
+    scanner.reset_stream();
+    scanner.scan(data, image.size(), [](u8, u64, const u8*) { return false; });
+    if (scanner.candidates != ordered.candidates || scanner.compares != ordered.compares) {
+        std::fprintf(stderr, "verify: scanner did %llu compares over %llu candidates, expected %llu over %llu\n",
+            (unsigned long long)scanner.compares, (unsigned long long)scanner.candidates,
+            (unsigned long long)ordered.compares, (unsigned long long)ordered.candidates);
+        std::exit(EXIT_FAILURE);
+    }
+
+    for (const auto& [name, stats] : { std::pair{"byte loop", bytes}, std::pair{"words, left to right", left_to_right}, std::pair{"words, by selectivity", ordered} }) {
+        std::printf("%-24s %12llu %12llu %10.3f\n", name, (unsigned long long)stats.candidates, (unsigned long long)stats.compares,
+            stats.wrong ? double(stats.wrong_compares) / stats.wrong : 0.0);
+    }
+}
+
+} // namespace
+
+// pass a dump of a title's code to also scan it through the mapped file source
+int main(int argc, char* argv[]) {
+    bench_multi_pattern();
+    bench_anchor();
+    bench_read_window();
+    check_straddle();
+    bench_stream();
+    bench_crc();
+    bench_dispatch();
+    bench_source(argc > 1 ? argv[1] : nullptr);
+    bench_split();
+    bench_verify(argc > 1 ? argv[1] : nullptr);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "switch.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+char fs_root[FS_MAX_PATH] = {0};
+u64 fs_open_count = {0};
+u64 fs_read_count = {0};
+u64 fs_write_count = {0};
+u64 fs_file_count = {0};
+
+static const char* full_path(const char* path, char* buf) {
+    snprintf(buf, FS_MAX_PATH, "%s%s", fs_root, path);
+    return buf;
+}
+
+Result fsOpenSdCardFileSystem(FsFileSystem* out) {
+    fs_open_count++;
+    return 0;
+}
+
+void fsFsClose(FsFileSystem* fs) {
+}
+
+Result fsFsOpenFile(FsFileSystem* fs, const char* path, u32 mode, FsFile* out) {
+    fs_file_count++;
+    char buf[FS_MAX_PATH] = {0};
+    const int flags = (mode & FsOpenMode_Write) ? ((mode & FsOpenMode_Read) ? O_RDWR : O_WRONLY) : O_RDONLY;
+    out->fd = open(full_path(path, buf), flags);
+    return out->fd < 0;
+}
+
+Result fsFsCreateFile(FsFileSystem* fs, const char* path, s64 size, u32 option) {
+    fs_file_count++;
+    char buf[FS_MAX_PATH] = {0};
+    const int fd = open(full_path(path, buf), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return 1;
+    }
+    const int rc = ftruncate(fd, size);
+    close(fd);
+    return rc != 0;
+}
+
+Result fsFsDeleteFile(FsFileSystem* fs, const char* path) {
+    fs_file_count++;
+    char buf[FS_MAX_PATH] = {0};
+    return unlink(full_path(path, buf)) != 0;
+}
+
+Result fsFsRenameFile(FsFileSystem* fs, const char* cur_path, const char* new_path) {
+    fs_file_count++;
+    char cur_buf[FS_MAX_PATH] = {0};
+    char new_buf[FS_MAX_PATH] = {0};
+    // like the sd card, renaming onto an existing file fails
+    if (access(full_path(new_path, new_buf), F_OK) == 0) {
+        return 1;
+    }
+    return rename(full_path(cur_path, cur_buf), new_buf) != 0;
+}
+
+void fsFileClose(FsFile* file) {
+    close(file->fd);
+}
+
+Result fsFileRead(FsFile* file, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read) {
+    fs_read_count++;
+    const ssize_t rc = pread(file->fd, buf, read_size, off);
+    *bytes_read = rc > 0 ? (u64)rc : 0;
+    return rc < 0;
+}
+
+Result fsFileWrite(FsFile* file, s64 off, const void* buf, u64 write_size, u32 option) {
+    fs_write_count++;
+    return pwrite(file->fd, buf, write_size, off) != (ssize_t)write_size;
+}
+
+Result fsFileGetSize(FsFile* file, s64* out) {
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) {
+        return 1;
+    }
+    *out = st.st_size;
+    return 0;
+}
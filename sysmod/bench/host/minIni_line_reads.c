@@ -0,0 +1,40 @@
+// minIni over the reader minGlue had before its read block, one fsFileRead per line.
+// everything is renamed with a line_ prefix, so that ini_bench can compare both readers.
+#define ini_read line_ini_read
+#define ini_getbool line_ini_getbool
+#define ini_getl line_ini_getl
+#define ini_gets line_ini_gets
+#define ini_getsection line_ini_getsection
+#define ini_getkey line_ini_getkey
+#define ini_hassection line_ini_hassection
+#define ini_haskey line_ini_haskey
+#define ini_putl line_ini_putl
+#define ini_puts line_ini_puts
+#define ini_browse line_ini_browse
+
+#include "../../../common/minIni/minIni.c"
+
+bool ini_read(char* buffer, u64 size, struct NxFile* nxfile) {
+    u64 bytes_read = {0};
+    if (R_FAILED(fsFileRead(&nxfile->file, nxfile->offset, buffer, size, FsReadOption_None, &bytes_read))) {
+        return false;
+    }
+
+    if (!bytes_read) {
+        return false;
+    }
+
+    char *eol = {0};
+
+    if ((eol = strchr(buffer, '\n')) == NULL) {
+        eol = strchr(buffer, '\r');
+    }
+
+    if (eol != NULL) {
+        *++eol = '\0';
+        bytes_read = eol - buffer;
+    }
+
+    nxfile->offset += bytes_read;
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// posix stand-in for the parts of libnx that minGlue and the overlay's ConfigQueue use, so that
+// they can be built and benchmarked on the host (see ../ini_bench.cpp). paths are relative to fs_root.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u32 Result;
+
+#define R_SUCCEEDED(rc) ((rc) == 0)
+#define R_FAILED(rc) ((rc) != 0)
+#define FS_MAX_PATH 0x301
+
+typedef struct { int unused; } FsFileSystem;
+typedef struct { int fd; } FsFile;
+
+enum { FsOpenMode_Read = 1, FsOpenMode_Write = 2, FsOpenMode_Append = 4 };
+enum { FsReadOption_None = 0 };
+enum { FsWriteOption_None = 0, FsWriteOption_Flush = 1 };
+
+extern char fs_root[FS_MAX_PATH];
+
+// number of calls, each of which is an ipc round trip on the switch
+extern u64 fs_open_count; // fsOpenSdCardFileSystem
+extern u64 fs_read_count; // fsFileRead
+extern u64 fs_write_count; // fsFileWrite
+extern u64 fs_file_count; // fsFsOpenFile, fsFsCreateFile, fsFsDeleteFile and fsFsRenameFile
+
+Result fsOpenSdCardFileSystem(FsFileSystem* out);
+void fsFsClose(FsFileSystem* fs);
+Result fsFsOpenFile(FsFileSystem* fs, const char* path, u32 mode, FsFile* out);
+Result fsFsCreateFile(FsFileSystem* fs, const char* path, s64 size, u32 option);
+Result fsFsDeleteFile(FsFileSystem* fs, const char* path);
+Result fsFsRenameFile(FsFileSystem* fs, const char* cur_path, const char* new_path);
+void fsFileClose(FsFile* file);
+Result fsFileRead(FsFile* file, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read);
+Result fsFileWrite(FsFile* file, s64 off, const void* buf, u64 write_size, u32 option);
+Result fsFileGetSize(FsFile* file, s64* out);
+
+// a pthread, the stack, priority and core are ignored
+typedef void (*ThreadFunc)(void*);
+typedef struct {
+    pthread_t handle;
+    ThreadFunc entry;
+    void* arg;
+} Thread;
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread* t);
+Result threadWaitForExit(Thread* t);
+Result threadClose(Thread* t);
+
+#if defined __cplusplus
+} // extern "C"
+#endif
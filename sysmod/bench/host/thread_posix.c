@@ -0,0 +1,30 @@
+#include "switch.h"
+
+static void* thread_entry(void* arg) {
+    Thread* t = arg;
+    t->entry(t->arg);
+    return NULL;
+}
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid) {
+    (void)stack_mem;
+    (void)stack_sz;
+    (void)prio;
+    (void)cpuid;
+    t->entry = entry;
+    t->arg = arg;
+    return 0;
+}
+
+Result threadStart(Thread* t) {
+    return pthread_create(&t->handle, NULL, thread_entry, t) != 0;
+}
+
+Result threadWaitForExit(Thread* t) {
+    return pthread_join(t->handle, NULL) != 0;
+}
+
+Result threadClose(Thread* t) {
+    (void)t;
+    return 0;
+}
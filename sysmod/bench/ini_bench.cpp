@@ -0,0 +1,405 @@
+// host benchmark for minGlue's reader in ../../common/minIni, built over the posix stand-in
+// for libnx in host/. looks up every key of a config like sys-dock's, through minIni over the
+// block reader and over the old one fsFileRead per line reader (host/minIni_line_reads.c).
+// also writes a log like sys-dock's, once with ini_puts() per key and once with IniWriter.
+// the "shared session" runs open the sd card once up front with ini_fs_init(), as main() does.
+// then checks that IniTable reads and rewrites a config the way minIni would, and that the
+// overlay's ConfigQueue only writes once toggling stops, or when the overlay hides or exits.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "minIni/minIni.h"
+#include "ini_table.hpp"
+#include "config_queue.hpp"
+#include "ini_writer.hpp"
+
+extern "C" {
+int line_ini_getbool(const char* Section, const char* Key, int DefValue, const char* Filename);
+int line_ini_haskey(const char* Section, const char* Key, const char* Filename);
+int line_ini_browse(INI_CALLBACK Callback, void* UserData, const char* Filename);
+}
+
+namespace {
+
+struct Key {
+    std::string section;
+    std::string key;
+};
+
+// the options and patch toggles of sys-dock, as main() writes them out
+auto make_config(const char* path) -> std::vector<Key> {
+    const std::vector<Key> keys{
+        { "options", "patch_sysmmc" }, { "options", "patch_emummc" }, { "options", "enable_logging" },
+        { "options", "version_skip" }, { "options", "parallel" },
+        { "nvservices", "no_lane_downgrade" }, { "nvservices", "no_bw_downgrade" },
+        { "nvservices", "force_bw_downgrade" }, { "nvservices", "force_full_render_pass" },
+        { "usb", "force_dp_mode_c" },
+    };
+
+    std::string text;
+    std::string section;
+    for (const auto& k : keys) {
+        if (k.section != section) {
+            section = k.section;
+            text += "[" + section + "]\n";
+        }
+        text += k.key + "=1\n";
+    }
+
+    auto file = std::fopen((std::string{fs_root} + path).c_str(), "wb");
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+    return keys;
+}
+
+// a log with every pattern's result and the stats, as the overlay browses it
+void make_log(const char* path) {
+    std::string text = "[nvservices]\n";
+    for (int i = 0; i < 8; i++) {
+        text += "pattern " + std::to_string(i) + "=Patched (sys-dock)\n";
+    }
+    text += "[usb]\n";
+    for (int i = 0; i < 3; i++) {
+        text += "pattern " + std::to_string(i) + "=Unpatched\n";
+    }
+    text += "[stats]\n";
+    for (int i = 0; i < 18; i++) {
+        text += "stat_" + std::to_string(i) + "=0123456789\n";
+    }
+
+    auto file = std::fopen((std::string{fs_root} + path).c_str(), "wb");
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+}
+
+void print_header() {
+    std::printf("%-32s %8s %8s %8s %8s %10s\n", "", "sessions", "files", "reads", "writes", "us");
+}
+
+template<typename F>
+void run(const char* name, F&& fn) {
+    double best{1e30};
+    u64 sessions{}, files{}, reads{}, writes{};
+    for (int i = 0; i < 20; i++) {
+        fs_open_count = fs_file_count = fs_read_count = fs_write_count = 0;
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+        sessions = fs_open_count;
+        files = fs_file_count;
+        reads = fs_read_count;
+        writes = fs_write_count;
+    }
+    std::printf("%-32s %8llu %8llu %8llu %8llu %10.1f\n", name, (unsigned long long)sessions,
+        (unsigned long long)files, (unsigned long long)reads, (unsigned long long)writes, best);
+}
+
+auto count_keys(const char*, const char*, const char*, void* user) -> int {
+    (*static_cast<int*>(user))++;
+    return 1;
+}
+
+struct Line {
+    std::string section;
+    std::string key;
+    std::string value;
+};
+
+// what main() logs: a result per pattern, then the stats
+auto make_log_lines(const std::vector<Key>& keys) -> std::vector<Line> {
+    std::vector<Line> lines;
+    for (const auto& k : keys) {
+        if (k.section != "options") {
+            lines.push_back({ k.section, k.key, "Patched (sys-dock)" });
+        }
+    }
+    for (const auto key : { "version", "build_date", "fw_version", "ams_version", "ams_target_version",
+        "ams_keygen", "ams_hash", "is_emummc", "heap_size", "buffer_size", "patch_time" }) {
+        lines.push_back({ "stats", key, "0123456789" });
+    }
+    for (const auto title : { "nvservices", "usb" }) {
+        for (const auto suffix : { "_bytes_read", "_code_size", "_attach_us" }) {
+            lines.push_back({ "stats", std::string{title} + suffix, "123456" });
+        }
+    }
+    return lines;
+}
+
+// the log as the overlay sees it
+auto browse_log(const char* path) -> std::string {
+    std::string out;
+    ini_browse([](const char* section, const char* key, const char* value, void* user) {
+        *static_cast<std::string*>(user) += std::string{section} + "/" + key + "=" + value + "\n";
+        return 1;
+    }, &out, path);
+    return out;
+}
+
+auto read_file(const char* path) -> std::string {
+    std::string text;
+    if (auto file = std::fopen((std::string{fs_root} + path).c_str(), "rb")) {
+        char buffer[256];
+        for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file));) {
+            text.append(buffer, n);
+        }
+        std::fclose(file);
+    }
+    return text;
+}
+
+void write_file(const char* path, const std::string& text) {
+    auto file = std::fopen((std::string{fs_root} + path).c_str(), "wb");
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+}
+
+auto file_exists(const char* path) -> bool {
+    return !access((std::string{fs_root} + path).c_str(), F_OK);
+}
+
+struct TableCase {
+    const char* name;
+    const char* before; // nullptr for no file
+    bool (*edit)(IniTable& table); // returns false if a lookup is wrong
+    const char* after;
+};
+
+// config.ini as the overlay and main() edit it, and what the file has to look like after save()
+const TableCase TABLE_CASES[]{
+    { "comments and quotes are kept",
+        "; sys-dock\n[options]\nenable_logging=0 ; to log.ini\nversion_skip = \"1\"\n# the end\n",
+        [](IniTable& t) {
+            const auto ok = !t.get_bool("options", "enable_logging", true) && t.get_bool("options", "version_skip", false);
+            return t.set("options", "enable_logging", 1) && t.set("options", "version_skip", 0) && ok;
+        },
+        "; sys-dock\n[options]\nenable_logging=1 ; to log.ini\nversion_skip = \"0\"\n# the end\n" },
+    { "inserts into existing and new sections",
+        "[options]\nparallel=1\n\n[usb]\nforce_dp_mode_c=0\n",
+        [](IniTable& t) {
+            return t.add("options", "patch_sysmmc", 1) && t.add("nvservices", "no_lane_downgrade", 0) &&
+                t.add("options", "parallel", 0) && t.get_bool("options", "parallel", false);
+        },
+        "[options]\nparallel=1\npatch_sysmmc=1\n\n[usb]\nforce_dp_mode_c=0\n[nvservices]\nno_lane_downgrade=0\n" },
+    { "set() of an added key",
+        "[options]\nparallel=1",
+        [](IniTable& t) {
+            return t.add("options", "version_skip", 1) && t.set("options", "version_skip", 0) &&
+                t.set("usb", "force_dp_mode_c", 1) && !t.get_bool("options", "version_skip", true);
+        },
+        "[options]\nparallel=1\nversion_skip=0\n[usb]\nforce_dp_mode_c=1\n" },
+    { "crlf line endings",
+        "[options]\r\nparallel=0\r\nversion_skip=1\r\n",
+        [](IniTable& t) {
+            return t.set("options", "parallel", 1) && t.add("options", "patch_emummc", 1) &&
+                t.get_bool("options", "version_skip", false) && t.has_key("OPTIONS", "Parallel");
+        },
+        "[options]\r\nparallel=1\r\nversion_skip=1\r\npatch_emummc=1\n" },
+    { "missing file",
+        nullptr,
+        [](IniTable& t) { return t.add("options", "parallel", 1) && !t.has_key("options", "version_skip"); },
+        "[options]\nparallel=1\n" },
+};
+
+// returns the number of failed checks
+auto check_ini_table(const char* path) -> int {
+    static IniTable table;
+    char temp_path[FS_MAX_PATH]{};
+    std::strcpy(temp_path, path);
+    temp_path[std::strlen(temp_path) - 1] = '~';
+
+    int failed{};
+    const auto check = [&](const char* name, bool ok) {
+        std::printf("%-44s %s\n", name, ok ? "ok" : "FAILED");
+        failed += !ok;
+    };
+
+    for (const auto& c : TABLE_CASES) {
+        ini_remove(path);
+        // a temporary file left over from a failed save is replaced
+        write_file(temp_path, "stale");
+        if (c.before) {
+            write_file(path, c.before);
+        }
+
+        const auto ok = table.load(path) && c.edit(table) && table.save(path);
+        const auto after = read_file(path);
+        check(c.name, ok && after == c.after && !file_exists(temp_path));
+        if (after != c.after) {
+            std::fprintf(stderr, "got:\n%s\nexpected:\n%s\n", after.c_str(), c.after);
+        }
+    }
+
+    // nothing changed, nothing written
+    write_file(path, "[options]\nparallel=1\n");
+    fs_write_count = 0;
+    check("unchanged file isn't written", table.load(path) && table.set("options", "parallel", 1) &&
+        table.add("options", "parallel", 0) && table.save(path) && !fs_write_count);
+
+    // a file that doesn't fit is left alone
+    const auto big = "[options]\n" + std::string(IniTable::MAX_SIZE, ';') + "\nparallel=1\n";
+    write_file(path, big);
+    const auto loaded = table.load(path);
+    table.add("options", "version_skip", 1);
+    table.save(path);
+    check("file too big is left alone", !loaded && read_file(path) == big);
+
+    ini_remove(path);
+    ini_remove(temp_path);
+    return failed;
+}
+
+// the overlay's toggles through ConfigQueue, as initServices(), onHide() and exitServices() use it.
+// returns the number of failed checks
+auto check_config_queue(const char* path) -> int {
+    static ConfigQueue queue{path};
+    using namespace std::chrono_literals;
+
+    int failed{};
+    const auto check = [&](const char* name, bool ok) {
+        std::printf("%-44s %s\n", name, ok ? "ok" : "FAILED");
+        failed += !ok;
+    };
+
+    const std::string before = "[options]\nparallel=0\n";
+    write_file(path, before);
+    queue.start();
+
+    // a mutually exclusive pair toggled quickly, well within the delay
+    fs_write_count = fs_file_count = 0;
+    for (int i = 0; i < 20; i++) {
+        queue.set("nvservices", "no_lane_downgrade", i & 1);
+        queue.set("nvservices", "no_bw_downgrade", !(i & 1));
+        std::this_thread::sleep_for(10ms);
+    }
+    check("no writes while toggling", !fs_write_count && !fs_file_count && read_file(path) == before);
+    check("get() returns the queued value", queue.get("nvservices", "no_lane_downgrade", false) &&
+        !queue.get("nvservices", "no_bw_downgrade", true) && !queue.get("options", "parallel", true));
+
+    std::this_thread::sleep_for(ConfigQueue::FLUSH_DELAY + 300ms);
+    check("one write after the delay", fs_write_count == 1 &&
+        read_file(path) == before + "[nvservices]\nno_lane_downgrade=1\nno_bw_downgrade=0\n");
+
+    // onHide()
+    queue.set("options", "parallel", 1);
+    queue.flush();
+    check("flush() writes right away", fs_write_count == 2 &&
+        read_file(path) == "[options]\nparallel=1\n[nvservices]\nno_lane_downgrade=1\nno_bw_downgrade=0\n");
+
+    // exitServices()
+    queue.set("usb", "force_dp_mode_c", 1);
+    queue.stop();
+    check("stop() writes what is left", fs_write_count == 3 &&
+        read_file(path) == "[options]\nparallel=1\n[nvservices]\nno_lane_downgrade=1\nno_bw_downgrade=0\n[usb]\nforce_dp_mode_c=1\n");
+
+    ini_remove(path);
+    return failed;
+}
+
+} // namespace
+
+int main() {
+    char root[] = "/tmp/sys-dock-ini-XXXXXX";
+    if (!mkdtemp(root)) {
+        std::fprintf(stderr, "couldn't create %s\n", root);
+        return EXIT_FAILURE;
+    }
+    std::strcpy(fs_root, root);
+
+    constexpr auto config_path = "/config.ini";
+    constexpr auto log_path = "/log.ini";
+    const auto keys = make_config(config_path);
+    make_log(log_path);
+
+    std::printf("== minGlue reader: haskey + getbool for each of %zu keys, browse of the log ==\n", keys.size());
+    print_header();
+
+    int line_sum{}, block_sum{};
+    run("startup keys, line reads", [&] {
+        line_sum = 0;
+        for (const auto& k : keys) {
+            line_sum += line_ini_haskey(k.section.c_str(), k.key.c_str(), config_path) && line_ini_getbool(k.section.c_str(), k.key.c_str(), 0, config_path);
+        }
+    });
+    run("startup keys, block reads", [&] {
+        block_sum = 0;
+        for (const auto& k : keys) {
+            block_sum += ini_haskey(k.section.c_str(), k.key.c_str(), config_path) && ini_getbool(k.section.c_str(), k.key.c_str(), 0, config_path);
+        }
+    });
+
+    int shared_sum{};
+    ini_fs_init();
+    run("startup keys, shared session", [&] {
+        shared_sum = 0;
+        for (const auto& k : keys) {
+            shared_sum += ini_haskey(k.section.c_str(), k.key.c_str(), config_path) && ini_getbool(k.section.c_str(), k.key.c_str(), 0, config_path);
+        }
+    });
+    ini_fs_exit();
+
+    int line_count{}, block_count{};
+    run("browse log, line reads", [&] { line_count = 0; line_ini_browse(count_keys, &line_count, log_path); });
+    run("browse log, block reads", [&] { block_count = 0; ini_browse(count_keys, &block_count, log_path); });
+
+    const auto lines = make_log_lines(keys);
+    std::printf("\n== log writing: %zu keys ==\n", lines.size());
+    print_header();
+
+    std::string puts_log, writer_log;
+    run("log, ini_puts per key", [&] {
+        ini_remove(log_path);
+        for (const auto& l : lines) {
+            ini_puts(l.section.c_str(), l.key.c_str(), l.value.c_str(), log_path);
+        }
+    });
+    puts_log = browse_log(log_path);
+    run("log, IniWriter", [&] {
+        auto log = std::make_unique<IniWriter>();
+        for (const auto& l : lines) {
+            log->put(l.section.c_str(), l.key.c_str(), l.value.c_str());
+        }
+        log->save(log_path);
+    });
+    writer_log = browse_log(log_path);
+    ini_fs_init();
+    run("log, IniWriter, shared session", [&] {
+        auto log = std::make_unique<IniWriter>();
+        for (const auto& l : lines) {
+            log->put(l.section.c_str(), l.key.c_str(), l.value.c_str());
+        }
+        log->save(log_path);
+    });
+    ini_fs_exit();
+
+    std::printf("\n== IniTable: load, add/set, save ==\n");
+    const auto table_failed = check_ini_table(config_path);
+
+    std::printf("\n== ConfigQueue: toggles, flush on hide and exit ==\n");
+    const auto queue_failed = check_config_queue(config_path);
+
+    unlink((std::string{root} + config_path).c_str());
+    unlink((std::string{root} + log_path).c_str());
+    rmdir(root);
+
+    if (line_sum != int(keys.size()) || block_sum != line_sum || shared_sum != line_sum || block_count != line_count || !block_count) {
+        std::fprintf(stderr, "readers disagree: %d/%d keys, %d/%d log entries\n", line_sum, block_sum, line_count, block_count);
+        return EXIT_FAILURE;
+    }
+    if (puts_log != writer_log || puts_log.empty()) {
+        std::fprintf(stderr, "logs differ:\n%s\nvs\n%s\n", puts_log.c_str(), writer_log.c_str());
+        return EXIT_FAILURE;
+    }
+    if (table_failed || queue_failed) {
+        std::fprintf(stderr, "%d IniTable and %d ConfigQueue checks failed\n", table_failed, queue_failed);
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -1,16 +1,28 @@
 #include <cstring>
 #include <span>
+#include <array>
 #include <algorithm> // for std::min
-#include <utility> // std::unreachable
+#include <utility> // std::unreachable, std::index_sequence
+#include <atomic>
 #include <switch.h>
 #include "minIni/minIni.h"
+#include "ini_table.hpp"
+#include "ini_writer.hpp"
+#include "scanner.hpp"
+#include "patterns.hpp"
 
 namespace {
 
 constexpr u64 INNER_HEAP_SIZE = 0x1000; // Size of the inner heap (adjust as necessary).
-constexpr u64 READ_BUFFER_SIZE = 0x1000; // size of static buffer which memory is read into
-constexpr u32 FW_VER_ANY = 0x0;
-constexpr u16 REGEX_SKIP = 0x100;
+constexpr u64 READ_BUFFER_SIZE = 0x8000; // size of each of the two static buffers which memory is read into, see Scratch
+constexpr u64 MIN_READ_SIZE = 0x1000; // size of the first read of each region, doubled on every read after
+constexpr u32 MAX_MODULES = 16; // rtld, main, subsdk0-9 and sdk, with room to spare
+constexpr u32 HINT_RADIUS = 0x1000; // how far around the offset of the last boot a pattern is searched first
+constexpr u32 HINT_MAX_RADIUS = 0x3000; // hint windows grow 4x on a miss, up to this
+constexpr u32 WORKER_COUNT = 2; // threads the titles, or the regions of a single title, are split between
+constexpr u64 WORKER_STACK_SIZE = 0x4000;
+constexpr int WORKER_PRIORITY = 49; // same as the main thread, see sys-dock.json
+constexpr u64 SPLIT_MIN_SIZE = 0x40000; // regions smaller than this aren't worth splitting between the workers
 
 u32 FW_VERSION{}; // set on startup
 u32 AMS_VERSION{}; // set on startup
@@ -18,397 +30,1165 @@ u32 AMS_TARGET_VERSION{}; // set on startup
 u8 AMS_KEYGEN{}; // set on startup
 u64 AMS_HASH{}; // set on startup
 bool VERSION_SKIP{}; // set on startup
+bool HAS_PMDMNT{}; // set on startup
+bool HAS_LDRDMNT{}; // set on startup
+bool PARALLEL{}; // set on startup, controlled by config.ini
 
-template<typename T>
-constexpr void str2hex(const char* s, T* data, u8& size) {
-    // skip leading 0x (if any)
-    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
-        s += 2;
+struct PatchEntry {
+    template<const auto& Table>
+    constexpr PatchEntry(const char* name, u64 title_id, PatternTable<Table>, u32 min_fw_ver = FW_VER_ANY, u32 max_fw_ver = FW_VER_ANY)
+        : name{name}
+        , title_id{title_id}
+        , patterns{Table}
+        , state{PatternTable<Table>::state}
+        , canonical{PatternTable<Table>::canonical}
+        , apply_match{PatternTable<Table>::apply_match}
+        , min_fw_ver{min_fw_ver}
+        , max_fw_ver{max_fw_ver} {
     }
 
-    // invalid string will cause a compile-time error due to no return
-    constexpr auto hexstr_2_nibble = [](char c) -> u8 {
-        if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
-        if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
-        if (c >= '0' && c <= '9') { return c - '0'; }
+    const char* name; // name of the system title
+    const u64 title_id; // title id of the system title
+    const std::span<const Patterns> patterns; // list of patterns to find
+    const std::span<PatternState> state; // of each pattern
+    const std::span<const u8> canonical; // see PatternTable::canonical
+    bool (*const apply_match)(PatchBatch& batch, u8 id, u64 addr, const u8* match); // see PatternTable::apply_match
+    const u32 min_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+    const u32 max_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+
+    u64 bytes_read{}; // how much code was read before every pattern was resolved (for logging)
+    u64 code_size{}; // size of all code regions (for logging)
+    u64 attach_ns{}; // how long the title was debug attached, and so suspended (for logging)
+};
+
+// NOTE: add system titles that you want to be patched to this table.
+// a list of system titles can be found here https://switchbrew.org/wiki/Title_list
+constinit PatchEntry patches[] = {
+    { "nvservices", 0x0100000000000019, pattern_table<nvservices_patterns> },
+    { "usb", 0x0100000000000006, pattern_table<usb_patterns> },
+};
+
+struct EmummcPaths {
+    char unk[0x80];
+    char nintendo[0x80];
+};
+
+void smcAmsGetEmunandConfig(EmummcPaths* out_paths) {
+    SecmonArgs args{};
+    args.X[0] = 0xF0000404; /* smcAmsGetEmunandConfig */
+    args.X[1] = 0; /* EXO_EMUMMC_MMC_NAND*/
+    args.X[2] = (u64)out_paths; /* out path */
+    svcCallSecureMonitor(&args);
+}
+
+auto is_emummc() -> bool {
+    EmummcPaths paths{};
+    smcAmsGetEmunandConfig(&paths);
+    return (paths.unk[0] != '\0') || (paths.nintendo[0] != '\0');
+}
+
+auto is_version_skipped(const Patterns& p) -> bool {
+    return VERSION_SKIP &&
+        ((p.min_fw_ver && p.min_fw_ver > FW_VERSION) ||
+        (p.max_fw_ver && p.max_fw_ver < FW_VERSION) ||
+        (p.min_ams_ver && p.min_ams_ver > AMS_VERSION) ||
+        (p.max_ams_ver && p.max_ams_ver < AMS_VERSION));
+}
+
+auto is_version_skipped(const PatchEntry& patch) -> bool {
+    return VERSION_SKIP &&
+        ((patch.min_fw_ver && patch.min_fw_ver > FW_VERSION) ||
+        (patch.max_fw_ver && patch.max_fw_ver < FW_VERSION));
+}
+
+// what needs to be searched for in each title.
+// built once on startup, after config.ini and the versions have been loaded.
+struct ScanPlan {
+    struct Title {
+        PatchEntry* patch;
+        MultiScanner scanner; // only the enabled, version-eligible patterns of the title
+        // patterns with the same bytes are only searched for once, under their canonical index.
+        // bit per index into PatchEntry::patterns, of the unresolved patterns that share the bytes
+        u32 groups[MultiScanner::MAX_PATTERNS];
+        u64 pid; // 0 if the title isn't running
+        Handle handle; // debug handle, while attached, see attach()
+        u64 attached_at; // tick of the attach, only set by attach() so that attach_ns is the time suspended
+        PatchBatch batch;
+        LoaderModuleInfo modules[MAX_MODULES]; // for the offset cache, see apply_patch()
+        s32 module_count;
+        u32 fingerprint; // of the code, see fingerprint_regions()
+        // bit per index into PatchEntry::patterns, of the patterns that were looked for in the code
+        // with that fingerprint, if it was scanned all the way. 0 if it wasn't, see apply_fingerprint()
+        u32 searched;
     };
 
-    // parse and convert string
-    while (*s != '\0') {
-        if (sizeof(T) == sizeof(u16) && *s == '.') {
-            data[size] = REGEX_SKIP;
-            s++;
-        } else {
-            data[size] |= hexstr_2_nibble(*s++) << 4;
-            data[size] |= hexstr_2_nibble(*s++) << 0;
+    Title titles[std::size(patches)];
+    u8 count{}; // titles with anything to search for
+};
+
+void build_scan_plan(ScanPlan& plan) {
+    for (auto& patch : patches) {
+        auto& title = plan.titles[plan.count];
+        title.patch = &patch;
+        title.scanner.clear();
+        title.pid = 0;
+        title.handle = 0;
+        title.attached_at = 0;
+        title.batch.count = 0;
+        title.module_count = 0;
+        title.fingerprint = 0;
+        title.searched = 0;
+        std::fill(std::begin(title.groups), std::end(title.groups), 0);
+
+        for (u8 i = 0; i < patch.patterns.size(); i++) {
+            const auto& p = patch.patterns[i];
+            auto& state = patch.state[i];
+
+            // skip if disabled (controller by config.ini)
+            if (state.result == PatchResult::DISABLED) {
+                continue;
+            }
+
+            // skip if version isn't valid
+            if (is_version_skipped(patch) || is_version_skipped(p)) {
+                state.result = PatchResult::SKIPPED;
+                continue;
+            }
+
+            // share the search with the other patterns with the same bytes
+            const auto id = patch.canonical[i];
+            if (!title.groups[id]) {
+                title.scanner.add(p.byte_pattern, id);
+            }
+            title.groups[id] |= 1U << i;
+        }
+
+        // no need to look at the title at all
+        if (!title.scanner.done()) {
+            plan.count++;
         }
-        size++;
     }
 }
 
-struct PatternData {
-    constexpr PatternData(const char* s) {
-        str2hex(s, data, size);
+// marks pattern i as resolved, the search stops once every pattern with the same bytes is resolved
+void resolve_pattern(ScanPlan::Title& title, u8 i) {
+    for (u8 id = 0; id < std::size(title.groups); id++) {
+        if (title.groups[id] & (1U << i)) {
+            title.groups[id] &= ~(1U << i);
+            if (!title.groups[id]) {
+                title.scanner.remove(id);
+            }
+            return;
+        }
     }
+}
 
-    u16 data[60]{}; // reasonable max pattern length, adjust as needed
-    u8 size{};
-};
+// what memory is read into. there's only the one set of buffers, which is split between the
+// workers when titles are patched in parallel
+alignas(0x1000) u8 read_memory[2 * READ_BUFFER_SIZE];
 
-struct PatchData {
-    constexpr PatchData(const char* s) {
-        str2hex(s, data, size);
+// the part of read_memory a title is read into: two buffers for DebugReadSource, which are used
+// as one buffer of twice the size everywhere else
+struct Scratch {
+    u8* data;
+    u64 buffer_size; // of each of the two
+
+    // the part of worker, out of workers
+    static auto of(u32 worker, u32 workers) -> Scratch {
+        const u64 size = sizeof(read_memory) / 2 / workers;
+        return { read_memory + worker * 2 * size, size };
     }
 
-    template<typename T>
-    constexpr PatchData(T v) {
-        for (u32 i = 0; i < sizeof(T); i++) {
-            data[size++] = v & 0xFF;
-            v >>= 8;
+    auto buffer(u32 slot) const -> u8* { return data + slot * buffer_size; }
+    auto all() const -> std::span<u8> { return { data, 2 * buffer_size }; }
+};
+
+// the hint windows are read in one go, see apply_hint()
+static_assert(2 * HINT_MAX_RADIUS + MAX_PATTERN_SIZE <= 2 * (READ_BUFFER_SIZE / WORKER_COUNT));
+
+Thread worker_threads[WORKER_COUNT];
+alignas(0x1000) u8 worker_stacks[WORKER_COUNT][WORKER_STACK_SIZE];
+
+// runs fn(i, worker) for every i in [0, count) on the workers, worker w on core w, and waits for
+// all of them. the stacks are static so that the heap stays at INNER_HEAP_SIZE.
+// if no worker can be started, everything runs on the calling thread as worker 0.
+template<typename F>
+void parallel_for(u32 count, F&& fn) {
+    struct Job {
+        F& fn;
+        const u32 count;
+        std::atomic<u32> next{};
+    };
+
+    struct Worker {
+        Job* job;
+        u32 index;
+
+        static void run(void* arg) {
+            const auto& w = *static_cast<Worker*>(arg);
+            for (u32 i; (i = w.job->next++) < w.job->count;) {
+                w.job->fn(i, w.index);
+            }
+        }
+    };
+
+    Job job{fn, count};
+    Worker workers[WORKER_COUNT]{};
+    u32 started{};
+
+    for (; started < WORKER_COUNT && started < count; started++) {
+        auto& thread = worker_threads[started];
+        workers[started] = { &job, started };
+        if (R_FAILED(threadCreate(&thread, Worker::run, &workers[started], worker_stacks[started], WORKER_STACK_SIZE, WORKER_PRIORITY, started))) {
+            break;
+        }
+        if (R_FAILED(threadStart(&thread))) {
+            threadClose(&thread);
+            break;
         }
     }
 
-    constexpr auto cmp(const void* _data) -> bool {
-        return !std::memcmp(data, _data, size);
+    if (!started) {
+        workers[0] = { &job, 0 };
+        Worker::run(&workers[0]);
     }
 
-    u8 data[24]{}; // reasonable max patch length, adjust as needed
-    u8 size{};
+    for (u32 w = 0; w < started; w++) {
+        threadWaitForExit(&worker_threads[w]);
+        threadClose(&worker_threads[w]);
+    }
+}
+
+// reads the region through the debug handle. the reads alternate between two buffers, as the
+// scanner needs the previous one for patterns that cross from one read into the next
+struct DebugReadSource {
+    Handle handle;
+    u64 addr;
+    u64 region_size;
+    Scratch scratch;
+    u32 slot{};
+
+    auto size() const -> u64 { return region_size; }
+    // start small as the patterns may be found early on, then grow the reads
+    // up to the size of the buffer to cut down on svc calls
+    auto min_read() const -> u64 { return MIN_READ_SIZE; }
+    auto max_read() const -> u64 { return scratch.buffer_size; }
+
+    auto read(u64 offset, u64 size) -> const u8* {
+        const auto data = scratch.buffer(slot);
+        if (R_FAILED(svcReadDebugProcessMemory(data, handle, addr + offset, size))) {
+            return nullptr;
+        }
+
+        slot ^= 1;
+        return data;
+    }
 };
 
-enum class PatchResult {
-    NOT_FOUND,
-    SKIPPED,
-    DISABLED,
-    PATCHED_FILE,
-    PATCHED_SYSDOCK,
-    FAILED_WRITE,
+// maps the region into sys-dock, so that it's scanned in place without being copied.
+// the kernel maps it read-write, and writes would go straight to the title's code, so write
+// access is dropped right after. kernels that don't allow that for the mapping keep it
+// read-write, which is why data is only ever handed out as const
+struct MappedSource {
+    Handle process;
+    u64 addr;
+    u64 region_size;
+    const u8* data;
+
+    auto map(Handle _process, u64 _addr, u64 size) -> bool {
+        virtmemLock();
+        const auto p = virtmemFindAslr(size, 0);
+        const auto mapped = p && R_SUCCEEDED(svcMapProcessMemory(p, _process, _addr, size));
+        virtmemUnlock();
+
+        if (mapped) {
+            svcSetMemoryPermission(p, size, Perm_R);
+        }
+        data = static_cast<const u8*>(p);
+
+        process = _process;
+        addr = _addr;
+        region_size = mapped ? size : 0;
+        return mapped;
+    }
+
+    void unmap() {
+        svcUnmapProcessMemory(const_cast<u8*>(data), process, addr, region_size);
+    }
+
+    auto size() const -> u64 { return region_size; }
+    // the whole region is handed out at once
+    auto min_read() const -> u64 { return region_size; }
+    auto max_read() const -> u64 { return region_size; }
+
+    auto read(u64 offset, u64 size) -> const u8* {
+        return data + offset;
+    }
 };
 
-struct Patterns {
-    const char* patch_name; // name of patch (unique per variant, used for logging)
-    const char* config_key; // config.ini key (shared among variants of the same logical patch)
-    const PatternData byte_pattern; // the pattern to search
+// hands a candidate at addr to every unresolved pattern with the bytes of id.
+// returns true once all of them are resolved
+auto apply_candidate(ScanPlan::Title& title, u8 id, u64 addr, const u8* match) -> bool {
+    auto& patch = *title.patch;
+    auto& group = title.groups[id];
+
+    for (auto bits = group; bits; bits &= bits - 1) {
+        const u8 i = std::countr_zero(bits);
+        if (patch.apply_match(title.batch, i, addr, match)) {
+            patch.state[i].match_addr = addr;
+            group &= ~(1U << i);
+        }
+    }
 
-    const s32 inst_offset; // instruction offset relative to byte pattern
-    const s32 patch_offset; // patch offset relative to inst_offset
+    return !group;
+}
 
-    bool (*const cond)(u32 inst); // check condition of the instruction
-    PatchData (*const patch)(u32 inst); // the patch data to be applied
-    bool (*const applied)(const u8* data, u32 inst); // check to see if patch already applied
+// scans the region starting at addr, until every pattern has been resolved.
+// returns how much of the region was read
+template<MemorySource Source>
+auto patcher(ScanPlan::Title& title, Source& source, u64 addr) -> u64 {
+    // every pattern is searched for in the same pass over the data
+    return title.scanner.scan_source(source, [&](u8 id, u64 offset, const u8* match) -> bool {
+        return apply_candidate(title, id, addr + offset, match);
+    });
+}
 
-    bool enabled; // controlled by config.ini
-    const s32 mutual_exclusivity_group{-1}; // patches with the same group (>= 0) are mutually exclusive
+// scans a mapped region on every worker at once, each over its own range with a copy of the scanner.
+// the first candidate of each pattern is then applied as in a single pass. if one is turned down
+// by its patterns, the rest of the region is scanned as usual from there.
+// returns how much of the region was read
+auto patcher_parallel(ScanPlan::Title& title, MappedSource& mapped) -> u64 {
+    // static as this runs on the main thread, which only has a small stack
+    static MultiScanner scanners[WORKER_COUNT];
+    static u64 first[WORKER_COUNT][MultiScanner::MAX_PATTERNS];
+
+    // the scanner only looks at whole instructions
+    const u64 range_size = (mapped.region_size / WORKER_COUNT + 3) & ~3ULL;
+    parallel_for(WORKER_COUNT, [&](u32 i, u32) {
+        const auto begin = std::min(i * range_size, mapped.region_size);
+        const auto end = i + 1 == WORKER_COUNT ? mapped.region_size : std::min(begin + range_size, mapped.region_size);
+        std::fill(std::begin(first[i]), std::end(first[i]), ~0ULL);
+        scanners[i] = title.scanner;
+        scanners[i].find_first(mapped.data, mapped.region_size, begin, end, first[i]);
+    });
+
+    u64 rejected = ~0ULL;
+    for (u8 id = 0; id < MultiScanner::MAX_PATTERNS; id++) {
+        u64 offset = ~0ULL;
+        for (const auto& f : first) {
+            offset = std::min(offset, f[id]);
+        }
+        if (offset == ~0ULL) {
+            continue;
+        }
 
-    const u32 min_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
-    const u32 max_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
-    const u32 min_ams_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
-    const u32 max_ams_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+        if (apply_candidate(title, id, mapped.addr + offset, mapped.data + offset)) {
+            title.scanner.remove(id);
+        } else {
+            rejected = std::min(rejected, offset);
+        }
+    }
 
-    PatchResult result{PatchResult::NOT_FOUND};
-};
+    if (rejected == ~0ULL) {
+        return mapped.region_size;
+    }
 
-struct PatchEntry {
-    const char* name; // name of the system title
-    const u64 title_id; // title id of the system title
-    const std::span<Patterns> patterns; // list of patterns to find
-    const u32 min_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
-    const u32 max_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+    // the candidates after the turned down ones
+    const auto start = rejected + 4;
+    MappedSource rest{ mapped.process, mapped.addr + start, mapped.region_size - start, mapped.data + start };
+    return start + patcher(title, rest, rest.addr);
+}
+
+// debug attaches to the title, which suspends it until detach()
+auto attach(ScanPlan::Title& title) -> bool {
+    if (title.handle) {
+        return true;
+    }
+
+    if (R_FAILED(svcDebugActiveProcess(&title.handle, title.pid))) {
+        title.handle = 0;
+        return false;
+    }
+
+    title.attached_at = armGetSystemTick();
+    return true;
+}
+
+void detach(ScanPlan::Title& title) {
+    if (!title.handle) {
+        return;
+    }
+
+    svcCloseHandle(title.handle);
+    title.handle = 0;
+    title.patch->attach_ns += armTicksToNs(armGetSystemTick() - title.attached_at);
+}
+
+// access to the memory of a title.
+// with a process handle everything goes through mappings, so the title only has to be
+// attached to (and suspended) for the writes. otherwise it's attached to on first use.
+struct TitleMemory {
+    ScanPlan::Title& title;
+    Handle process;
+
+    auto query(MemoryInfo& mem_info, u64 addr) -> bool {
+        u32 page_info{};
+        if (process) {
+            return R_SUCCEEDED(svcQueryProcessMemory(&mem_info, &page_info, process, addr));
+        }
+        return attach(title) && R_SUCCEEDED(svcQueryDebugProcessMemory(&mem_info, &page_info, title.handle, addr));
+    }
+
+    auto read(void* out, u64 addr, u64 size) -> bool {
+        if (process) {
+            // mappings have to be page aligned
+            const auto start = addr & ~0xFFFULL;
+            const auto end = (addr + size + 0xFFF) & ~0xFFFULL;
+            MappedSource mapped{};
+            if (mapped.map(process, start, end - start)) {
+                std::memcpy(out, mapped.data + (addr - start), size);
+                mapped.unmap();
+                return true;
+            }
+        }
+        return attach(title) && R_SUCCEEDED(svcReadDebugProcessMemory(out, title.handle, addr, size));
+    }
 };
 
-constexpr auto movz_cond(u32 inst) -> bool {
-    return (inst >> 24) == 0x52; // MOVZ Wn, #imm
-}
-
-constexpr auto strb_cond(u32 inst) -> bool {
-    return (inst >> 24) == 0x39; // STRB Wt, [Xn, #imm]
-}
-
-constexpr auto tbnz_cond(u32 inst) -> bool {
-    return (inst >> 24) == 0x37; // TBNZ Rt, #imm, label
-}
-
-constexpr auto cbz_cond(u32 inst) -> bool {
-    return (inst >> 24) == 0x34; // CBZ Rt, label
-}
-
-constexpr auto bcond_cond(u32 inst) -> bool {
-    return (inst >> 24) == 0x54; // B.cond label
-}
-
-constexpr auto bcond_or_tbnz_cond(u32 inst) -> bool {
-    return bcond_cond(inst) || tbnz_cond(inst);
-}
-
-constexpr auto bic_w8_w8_wm_lsr2_cond(u32 inst) -> bool {
-    // wildcard only Rm (bits 20..16)
-    return (inst & 0xFFE0FFFFu) == 0x0A600908u; // BIC w8, w8, Rm, lsr #2
-}
-
-// to view patches, use https://armconverter.com/?lock=arm64
-constexpr PatchData nop_patch_data{ "0x1F2003D5" };
-constexpr PatchData nop5_patch_data{ "0x1F2003D51F2003D51F2003D51F2003D51F2003D5" };
-constexpr PatchData nop6_patch_data{ "0x1F2003D51F2003D51F2003D51F2003D51F2003D51F2003D5" };
-constexpr PatchData mov_w9_0x406_patch_data{ "0xC9808052" };
-constexpr PatchData mov_w20_0x406_patch_data{ "0xD4808052" };
-constexpr PatchData mov_w8_2_patch_data{ "0x48008052" };
-
-constexpr auto nop_patch(u32 inst) -> PatchData { return nop_patch_data; }
-constexpr auto nop5_patch(u32 inst) -> PatchData { return nop5_patch_data; }
-constexpr auto nop6_patch(u32 inst) -> PatchData { return nop6_patch_data; }
-constexpr auto mov_w9_0x406_patch(u32 inst) -> PatchData { return mov_w9_0x406_patch_data; }
-constexpr auto mov_w20_0x406_patch(u32 inst) -> PatchData { return mov_w20_0x406_patch_data; }
-constexpr auto mov_w8_2_patch(u32 inst) -> PatchData { return mov_w8_2_patch_data; }
-
-constexpr auto nop_applied(const u8* data, u32 inst) -> bool { return nop_patch(inst).cmp(data); }
-constexpr auto nop5_applied(const u8* data, u32 inst) -> bool { return nop5_patch(inst).cmp(data); }
-constexpr auto nop6_applied(const u8* data, u32 inst) -> bool { return nop6_patch(inst).cmp(data); }
-constexpr auto mov_w9_0x406_applied(const u8* data, u32 inst) -> bool { return mov_w9_0x406_patch(inst).cmp(data); }
-constexpr auto mov_w20_0x406_applied(const u8* data, u32 inst) -> bool { return mov_w20_0x406_patch(inst).cmp(data); }
-constexpr auto mov_w8_2_applied(const u8* data, u32 inst) -> bool { return mov_w8_2_patch(inst).cmp(data); }
-
-
-constinit Patterns nvservices_patterns[] = {
-    // 79 01 00 34  CBZ     W25, loc_7100042540     <-- nop
-    // 2A 05 91 52  MOV     W10, #0x48829           <-- nop
-    // 8A 00 A0 72                                  <-- nop
-    // FF 02 0A 6B  CMP     W23, W10                <-- nop
-    // E3 00 00 54  B.CC    loc_7100042540          <-- nop
-    // 69 EE 0C 39  STRB    W9, [X19,#(g_dp_lane_count)]
-    { "21.0.0+ no_lane_downgrade", "no_lane_downgrade", "0x...34.059152.00a072...6b...54.ee0c39", 0, 0, cbz_cond, nop5_patch, nop5_applied, false, -1, MAKEHOSVERSION(21,0,0), FW_VER_ANY},
-    // same as above, but there's an extra LDUR after the CBZ
-    { "17.0.0-17.0.1 no_lane_downgrade", "no_lane_downgrade", "0x...34.....059152.00a072...6b...54.ee0c39", 0, 0, cbz_cond, nop6_patch, nop6_applied, false, -1, MAKEHOSVERSION(17,0,0), MAKEHOSVERSION(17,0,1)},
-    // 2A 05 91 52  MOV     W10, #0x48829
-    // 8A 00 A0 72
-    // FF 02 0A 6B  CMP     W23, W10
-    // 42 00 00 54  B.CS    loc_71000405C0
-    // 49 00 80 52  MOV     W9, #2                  <-- nop
-    // 69 EE 0C 39  STRB    W9, [X19,#(g_dp_lane_count)]
-    { "11.0.0-16.1.0 no_lane_downgrade", "no_lane_downgrade", "0x.059152.00a072...6b...54.008052.ee0c39", 16, 0, movz_cond, nop_patch, nop_applied, false, -1, MAKEHOSVERSION(11,0,0), MAKEHOSVERSION(16,1,0)},
-    // same as above, just because of no_lane_downgrade_2 we need to put next FW versions in separate table
-    { "18.0.0-20.5.0 no_lane_downgrade", "no_lane_downgrade", "0x.059152.00a072...6b...54.008052.ee0c39", 16, 0, movz_cond, nop_patch, nop_applied, false, -1, MAKEHOSVERSION(18,0,0), MAKEHOSVERSION(20,5,0)},
-    // 61 00 00 54  B.NE    loc_71000427B4
-    // 48 01 80 52  MOV     W8, #0xA
-    // 68 E6 0C 39  STRB    W8, [X19,#(g_dp_current_link_bw)]   <-- nop
-    // 61 E6 0C 91  ADD     X1, X19, #0x339
-    // 62 EA 0C 91  ADD     X2, X19, #0x33A
-    { "no_bw_downgrade", "no_bw_downgrade", "0x.....018052.e60c39..0c91..0c91", 8, 0, strb_cond, nop_patch, nop_applied, false, 0, MAKEHOSVERSION(11,0,0), FW_VER_ANY},
-    // same pattern as above, except we nop the B.NE and force the STRB
-    { "force_bw_downgrade", "force_bw_downgrade", "0x.....018052.e60c39..0c91..0c91", 0, 0, bcond_or_tbnz_cond, nop_patch, nop_applied, false, 0, MAKEHOSVERSION(11,0,0), FW_VER_ANY},
-    // 28 00 80 52  MOV     W8, #1
-    // 08 09 79 0A  BIC     W8, W8, W25, LSR#2      <-- MOV W8, #2
-    { "11.0.0-14.1.2 force_full_render_pass", "force_full_render_pass", "0x280080520809.0A", 4, 0, bic_w8_w8_wm_lsr2_cond, mov_w8_2_patch, mov_w8_2_applied, false, -1, MAKEHOSVERSION(11,0,0), MAKEHOSVERSION(14,1,2) },
-    // 08 09 79 0A  BIC     W8, W8, W25, LSR#2      <-- MOV W8, #2
-    // E0 03 1A AA  MOV     X0, X26
-    { "15.0.0+ force_full_render_pass", "force_full_render_pass", "0x0809.0AE003.AA", 0, 0, bic_w8_w8_wm_lsr2_cond, mov_w8_2_patch, mov_w8_2_applied, false, -1, MAKEHOSVERSION(15,0,0), FW_VER_ANY },
+// writes the queued patches, merging the writes that overlap or are next to each other.
+// every write is read back. if one fails, the ones before it are undone so that the title is
+// never left half patched.
+auto write_batch(Handle handle, PatchBatch& batch, std::span<PatternState> state) -> bool {
+    auto writes = std::span{batch.writes, batch.count};
+    batch.count = 0;
+
+    std::sort(writes.begin(), writes.end(), [](const auto& a, const auto& b) {
+        return a.addr < b.addr;
+    });
+
+    u8 count{};
+    for (const auto& w : writes) {
+        if (count) {
+            auto& last = writes[count - 1];
+            const auto last_end = last.addr + last.size;
+            const auto end = std::max(last_end, w.addr + w.size);
+
+            if (w.addr <= last_end && end - last.addr <= PatchBatch::MAX_WRITE_SIZE) {
+                // the original bytes in front of last_end are already saved
+                const auto covered = last_end - w.addr;
+                if (end > last_end) {
+                    std::memcpy(last.original + last.size, w.original + covered, w.size - covered);
+                }
+                std::memcpy(last.data + (w.addr - last.addr), w.data, w.size);
+                last.size = end - last.addr;
+                last.patterns |= w.patterns;
+                continue;
+            }
+        }
+        writes[count++] = w;
+    }
+    writes = writes.first(count);
+
+    for (u8 i = 0; i < writes.size(); i++) {
+        u8 written[PatchBatch::MAX_WRITE_SIZE]{};
+        if (R_SUCCEEDED(svcWriteDebugProcessMemory(handle, writes[i].data, writes[i].addr, writes[i].size)) &&
+            R_SUCCEEDED(svcReadDebugProcessMemory(written, handle, writes[i].addr, writes[i].size)) &&
+            !std::memcmp(written, writes[i].data, writes[i].size)) {
+            continue;
+        }
+
+        // undo everything, including the failed write in case part of it went through
+        for (u8 j = i + 1; j--;) {
+            svcWriteDebugProcessMemory(handle, writes[j].original, writes[j].addr, writes[j].size);
+        }
+
+        for (const auto& w : writes) {
+            for (u8 id = 0; id < state.size(); id++) {
+                if (w.patterns & (1U << id)) {
+                    state[id].result = PatchResult::FAILED_WRITE;
+                }
+            }
+        }
+        return false;
+    }
+
+    return true;
+}
+
+// where the patterns were found on the last boot, so that they can be checked with one
+// small read each instead of scanning the whole title.
+// the offsets are relative to the module they were found in, as modules are loaded at
+// random addresses, and only used if the module's build id is the same.
+// after an update, the offsets of the old builds are where the patterns are searched first.
+// the fingerprint of each title's code is kept as well, so that the scan is skipped altogether
+// while the code stays the same.
+struct OffsetCache {
+    static constexpr u32 MAGIC = 0x32434453; // "SDC2"
+    static constexpr u32 MAX_ENTRIES = 64; // more than the patterns of every title combined
+    static constexpr u32 MAX_SCANS = 8;
+    static_assert(std::size(patches) <= MAX_SCANS);
+
+    // the last complete scan of a title
+    struct Scan {
+        u64 title_id;
+        u32 fingerprint; // see fingerprint_regions()
+        u32 searched; // see ScanPlan::Title::searched
+    };
+
+    struct Entry {
+        u64 title_id;
+        u8 build_id[8]; // start of the module's build id
+        u32 offset; // of the pattern, relative to the module
+        u8 pattern; // index into PatchEntry::patterns
+        u8 module; // index into the title's modules, for the hint once the build id changes
+        u8 reserved[2];
+    };
+
+    u32 magic;
+    u32 fw_version; // of the last boot
+    u32 count;
+    u32 reserved;
+    Scan scans[MAX_SCANS];
+    Entry entries[MAX_ENTRIES];
 };
 
-constinit Patterns usb_patterns[] = {
-    // C0 03 5F D6  RET
-    // D4 00 81 52  MOV     W20, #0x806             <-- 0x406
-    { "15.0.0+ force_dp_mode_c", "force_dp_mode_c", "0xC0035FD6D4008152", 4, 0, movz_cond, mov_w20_0x406_patch, mov_w20_0x406_applied, false, -1, MAKEHOSVERSION(15,0,0), FW_VER_ANY},
-    // C0 10 84 52  MOV     W0, #0x2086
-    // DC FF FF 17  B       loc_7100054E38
-    // D4 00 81 52  MOV     W20, #0x806             <-- 0x406
-    { "12.0.0-14.1.2 force_dp_mode_c", "force_dp_mode_c", "0xC0108452....D4008152", 8, 0, movz_cond, mov_w20_0x406_patch, mov_w20_0x406_applied, false, -1, MAKEHOSVERSION(12,0,0), MAKEHOSVERSION(14,1,2)},
-    // 1F 01 0E 72  TST     W8, #0x40000
-    // C8 80 80 52  MOV     W8, #0x406
-    // C9 00 81 52  MOV     W9, #0x806              <-- 0x406
-    { "11.0.0-11.0.1 force_dp_mode_c", "force_dp_mode_c", "0x1F010E72C8808052C9008152", 8, 0, movz_cond, mov_w9_0x406_patch, mov_w9_0x406_applied, false, -1, MAKEHOSVERSION(11,0,0), MAKEHOSVERSION(11,0,1)},
+OffsetCache offset_cache{};
+bool offset_cache_dirty{};
+
+auto find_module(std::span<const LoaderModuleInfo> modules, const u8* build_id) -> const LoaderModuleInfo* {
+    for (const auto& m : modules) {
+        if (!std::memcmp(m.build_id, build_id, sizeof(OffsetCache::Entry::build_id))) {
+            return &m;
+        }
+    }
+    return nullptr;
+}
+
+// continues crc with the size and every byte of the region.
+// mapped regions are read in place, others are copied out through the buffer.
+// returns false if the region couldn't be read
+auto crc_region(TitleMemory& mem, std::span<u8> buffer, const MemoryInfo& mem_info, u32& crc) -> bool {
+    crc = crc32c(crc, &mem_info.size, sizeof(mem_info.size));
+
+    MappedSource mapped{};
+    if (mem.process && mapped.map(mem.process, mem_info.addr, mem_info.size)) {
+        crc = crc32c(crc, mapped.data, mem_info.size);
+        mapped.unmap();
+        return true;
+    }
+
+    for (u64 offset = 0; offset < mem_info.size; offset += buffer.size()) {
+        const auto size = std::min<u64>(buffer.size(), mem_info.size - offset);
+        if (!mem.read(buffer.data(), mem_info.addr + offset, size)) {
+            return false;
+        }
+        crc = crc32c(crc, buffer.data(), size);
+    }
+    return true;
+}
+
+// fingerprints the code regions the scan would go through, all of them in full, so that a
+// later boot can tell whether the code is still what was scanned then, see apply_fingerprint().
+// without ldr:dmnt, each region also stands in for a module, with its crc32c in place of the build id.
+// returns false if a region couldn't be read
+auto fingerprint_regions(ScanPlan::Title& title, TitleMemory& mem, std::span<u8> buffer, bool as_modules) -> bool {
+    auto& patch = *title.patch;
+    MemoryInfo mem_info{};
+    u64 addr{};
+    u32 crc{};
+    s32 count{};
+
+    for (;;) {
+        if (!mem.query(mem_info, addr)) {
+            break;
+        }
+        addr = mem_info.addr + mem_info.size;
+
+        // if addr=0 then we hit the reserved memory section
+        if (!addr) {
+            break;
+        }
+        // skip memory that we don't want
+        if (!mem_info.size || (mem_info.perm & Perm_Rx) != Perm_Rx || ((mem_info.type & 0xFF) != MemType_CodeStatic)) {
+            continue;
+        }
+
+        u32 region_crc{};
+        if (!crc_region(mem, buffer, mem_info, region_crc)) {
+            return false;
+        }
+        patch.bytes_read += mem_info.size;
+        crc = crc32c(crc, &region_crc, sizeof(region_crc));
+
+        if (as_modules && static_cast<size_t>(count) < std::size(title.modules)) {
+            auto& m = title.modules[count++];
+            m = {};
+            std::memcpy(m.build_id, &region_crc, sizeof(region_crc));
+            m.base_address = mem_info.addr;
+            m.size = mem_info.size;
+        }
+    }
+
+    if (as_modules) {
+        title.module_count = count;
+    }
+    title.fingerprint = crc;
+    return true;
+}
+
+void load_offset_cache(const char* path) {
+    FsFileSystem own_fs{};
+    FsFile file{};
+    char path_buf[FS_MAX_PATH]{};
+    u64 bytes_read{};
+    bool valid{};
+
+    if (const auto fs = ini_fs_open(&own_fs)) {
+        std::strcpy(path_buf, path);
+        if (R_SUCCEEDED(fsFsOpenFile(fs, path_buf, FsOpenMode_Read, &file))) {
+            valid = R_SUCCEEDED(fsFileRead(&file, 0, &offset_cache, sizeof(offset_cache), FsReadOption_None, &bytes_read)) &&
+                bytes_read >= offsetof(OffsetCache, entries) &&
+                offset_cache.magic == OffsetCache::MAGIC &&
+                offset_cache.count <= OffsetCache::MAX_ENTRIES &&
+                bytes_read >= offsetof(OffsetCache, entries) + offset_cache.count * sizeof(OffsetCache::Entry);
+            fsFileClose(&file);
+        }
+        ini_fs_close(fs);
+    }
+
+    if (!valid) {
+        offset_cache = {};
+        offset_cache.magic = OffsetCache::MAGIC;
+    }
+
+    // the entries of the old firmware are kept as hints until they're replaced
+    if (offset_cache.fw_version != FW_VERSION) {
+        offset_cache.fw_version = FW_VERSION;
+        offset_cache_dirty = true;
+    }
+}
+
+auto save_offset_cache(const char* path) -> bool {
+    FsFileSystem own_fs{};
+    FsFile file{};
+    char path_buf[FS_MAX_PATH]{};
+    Result rc{};
+
+    if (!offset_cache_dirty) {
+        return true;
+    }
+
+    const auto fs = ini_fs_open(&own_fs);
+    if (!fs) {
+        return false;
+    }
+
+    const auto size = offsetof(OffsetCache, entries) + offset_cache.count * sizeof(OffsetCache::Entry);
+    std::strcpy(path_buf, path);
+    fsFsDeleteFile(fs, path_buf);
+    if (R_SUCCEEDED(rc = fsFsCreateFile(fs, path_buf, size, 0)) &&
+        R_SUCCEEDED(rc = fsFsOpenFile(fs, path_buf, FsOpenMode_Write, &file))) {
+        rc = fsFileWrite(&file, 0, &offset_cache, size, FsWriteOption_Flush);
+        fsFileClose(&file);
+    }
+    ini_fs_close(fs);
+    return R_SUCCEEDED(rc);
+}
+
+// offset of a pattern in a known build of a module, so that it can be patched
+// without scanning or a cache. they're only loaded from offset_db.bin on the sd card,
+// sorted by build id, then patch name, as it's binary searched.
+struct OffsetRecord {
+    u8 build_id[0x20]; // as reported by ldr:dmnt, zero padded
+    char patch_name[48]; // Patterns::patch_name
+    u32 offset; // of the byte pattern, relative to the module
+
+    constexpr auto operator<(const OffsetRecord& rhs) const -> bool {
+        for (u32 i = 0; i < sizeof(build_id); i++) {
+            if (build_id[i] != rhs.build_id[i]) {
+                return build_id[i] < rhs.build_id[i];
+            }
+        }
+        for (u32 i = 0; i < sizeof(patch_name); i++) {
+            if (patch_name[i] != rhs.patch_name[i]) {
+                return static_cast<u8>(patch_name[i]) < static_cast<u8>(rhs.patch_name[i]);
+            }
+        }
+        return false;
+    }
 };
 
-// NOTE: add system titles that you want to be patched to this table.
-// a list of system titles can be found here https://switchbrew.org/wiki/Title_list
-constinit PatchEntry patches[] = {
-    { "nvservices", 0x0100000000000019, nvservices_patterns },
-    { "usb", 0x0100000000000006, usb_patterns },
+// compares only the build id, to find every record of a module
+struct BuildIdLess {
+    auto operator()(const OffsetRecord& record, const u8* build_id) const -> bool {
+        return std::memcmp(record.build_id, build_id, sizeof(record.build_id)) < 0;
+    }
+
+    auto operator()(const u8* build_id, const OffsetRecord& record) const -> bool {
+        return std::memcmp(build_id, record.build_id, sizeof(record.build_id)) < 0;
+    }
 };
 
-struct EmummcPaths {
-    char unk[0x80];
-    char nintendo[0x80];
+// the layout of offset_db.bin
+struct OffsetDb {
+    static constexpr u32 MAGIC = 0x31424453; // "SDB1"
+    static constexpr u32 MAX_RECORDS = 128;
+
+    u32 magic;
+    u32 count;
+    OffsetRecord records[MAX_RECORDS];
 };
 
-void smcAmsGetEmunandConfig(EmummcPaths* out_paths) {
-    SecmonArgs args{};
-    args.X[0] = 0xF0000404; /* smcAmsGetEmunandConfig */
-    args.X[1] = 0; /* EXO_EMUMMC_MMC_NAND*/
-    args.X[2] = (u64)out_paths; /* out path */
-    svcCallSecureMonitor(&args);
+OffsetDb offset_db{};
+
+void load_offset_db(const char* path) {
+    FsFileSystem own_fs{};
+    FsFile file{};
+    char path_buf[FS_MAX_PATH]{};
+    u64 bytes_read{};
+    bool valid{};
+
+    if (const auto fs = ini_fs_open(&own_fs)) {
+        std::strcpy(path_buf, path);
+        if (R_SUCCEEDED(fsFsOpenFile(fs, path_buf, FsOpenMode_Read, &file))) {
+            valid = R_SUCCEEDED(fsFileRead(&file, 0, &offset_db, sizeof(offset_db), FsReadOption_None, &bytes_read)) &&
+                bytes_read >= offsetof(OffsetDb, records) &&
+                offset_db.magic == OffsetDb::MAGIC &&
+                offset_db.count <= OffsetDb::MAX_RECORDS &&
+                bytes_read >= offsetof(OffsetDb, records) + offset_db.count * sizeof(OffsetRecord) &&
+                std::is_sorted(offset_db.records, offset_db.records + offset_db.count);
+            fsFileClose(&file);
+        }
+        ini_fs_close(fs);
+    }
+
+    if (!valid) {
+        offset_db.count = 0;
+    }
 }
 
-auto is_emummc() -> bool {
-    EmummcPaths paths{};
-    smcAmsGetEmunandConfig(&paths);
-    return (paths.unk[0] != '\0') || (paths.nintendo[0] != '\0');
+// checks the pattern at addr with one read and patches it.
+// returns true if the pattern was resolved, otherwise it's left to the scan
+auto apply_known(ScanPlan::Title& title, TitleMemory& mem, u8 i, u64 addr) -> bool {
+    auto& patch = *title.patch;
+    const auto& p = patch.patterns[i];
+
+    // skip patterns that are disabled, version skipped or already resolved
+    if (patch.state[i].result != PatchResult::NOT_FOUND) {
+        return false;
+    }
+
+    u8 data[MAX_PATTERN_SIZE]{};
+    if (!mem.read(data, addr, p.byte_pattern.size)) {
+        return false;
+    }
+
+    patch.bytes_read += p.byte_pattern.size;
+    if (!pattern_match(p.byte_pattern, data) || !patch.apply_match(title.batch, i, addr, data)) {
+        return false;
+    }
+
+    patch.state[i].match_addr = addr;
+    resolve_pattern(title, i);
+    return true;
+}
+
+// patches the patterns of every module whose build id has records
+void apply_offset_db(ScanPlan::Title& title, TitleMemory& mem, std::span<const LoaderModuleInfo> modules) {
+    auto& patch = *title.patch;
+
+    const std::span<const OffsetRecord> records{offset_db.records, offset_db.count};
+
+    for (const auto& module : modules) {
+        // every record of the build id
+        const auto [first, last] = std::equal_range(records.begin(), records.end(), static_cast<const u8*>(module.build_id), BuildIdLess{});
+
+        for (const auto& record : std::span{first, last}) {
+            for (u8 i = 0; i < patch.patterns.size(); i++) {
+                if (!std::strncmp(patch.patterns[i].patch_name, record.patch_name, sizeof(record.patch_name)) &&
+                    record.offset + patch.patterns[i].byte_pattern.size <= module.size) {
+                    apply_known(title, mem, i, module.base_address + record.offset);
+                    break;
+                }
+            }
+        }
+    }
 }
 
-void patcher(Handle handle, const u8* data, size_t data_size, u64 addr, std::span<Patterns> patterns) {
-    for (auto& p : patterns) {
-        // skip if disabled (controller by config.ini)
-        if (p.result == PatchResult::DISABLED) {
+// patches the patterns found at their offsets of the last boot
+void apply_cached(ScanPlan::Title& title, TitleMemory& mem, std::span<const LoaderModuleInfo> modules) {
+    const auto& patch = *title.patch;
+
+    for (const auto& e : std::span{offset_cache.entries, offset_cache.count}) {
+        if (e.title_id != patch.title_id || e.pattern >= patch.patterns.size()) {
             continue;
         }
 
-        // skip if version isn't valid
-        if (VERSION_SKIP &&
-            ((p.min_fw_ver && p.min_fw_ver > FW_VERSION) ||
-            (p.max_fw_ver && p.max_fw_ver < FW_VERSION) ||
-            (p.min_ams_ver && p.min_ams_ver > AMS_VERSION) ||
-            (p.max_ams_ver && p.max_ams_ver < AMS_VERSION))) {
-            p.result = PatchResult::SKIPPED;
+        const auto module = find_module(modules, e.build_id);
+        if (!module || e.offset + patch.patterns[e.pattern].byte_pattern.size > module->size) {
             continue;
         }
 
-        // skip if already patched
-        if (p.result == PatchResult::PATCHED_FILE || p.result == PatchResult::PATCHED_SYSDOCK) {
+        // anything that no longer matches is found by the scan instead
+        apply_known(title, mem, e.pattern, module->base_address + e.offset);
+    }
+}
+
+auto find_scan(u64 title_id) -> OffsetCache::Scan* {
+    for (auto& scan : offset_cache.scans) {
+        if (scan.title_id == title_id) {
+            return &scan;
+        }
+    }
+    return nullptr;
+}
+
+// if the code is the same as on the last complete scan of the title, the scan would find the same.
+// so the patterns are patched at the offsets found then without being compared, and the ones that
+// weren't found aren't searched for. returns false if the scan can't be skipped
+auto apply_fingerprint(ScanPlan::Title& title, TitleMemory& mem, std::span<const LoaderModuleInfo> modules) -> bool {
+    auto& patch = *title.patch;
+
+    u32 unresolved{};
+    for (const auto group : title.groups) {
+        unresolved |= group;
+    }
+
+    const auto scan = find_scan(patch.title_id);
+    if (!scan || scan->fingerprint != title.fingerprint || (unresolved & ~scan->searched)) {
+        return false;
+    }
+
+    for (const auto& e : std::span{offset_cache.entries, offset_cache.count}) {
+        if (e.title_id != patch.title_id || e.pattern >= patch.patterns.size() || !(unresolved & (1U << e.pattern)) ||
+            e.module >= modules.size() || std::memcmp(modules[e.module].build_id, e.build_id, sizeof(e.build_id))) {
             continue;
         }
 
-        for (u32 i = 0; i < data_size; i++) {
-            if (i + p.byte_pattern.size >= data_size) {
-                break;
-            }
+        const auto& module = modules[e.module];
+        const auto size = patch.patterns[e.pattern].byte_pattern.size;
+        u8 data[MAX_PATTERN_SIZE]{};
+        if (e.offset + size > module.size || !mem.read(data, module.base_address + e.offset, size)) {
+            return false;
+        }
+        patch.bytes_read += size;
 
-            // loop through every byte of the pattern data to find a match
-            // skipping over any bytes if the value is REGEX_SKIP
-            u32 count{};
-            while (count < p.byte_pattern.size) {
-                if (p.byte_pattern.data[count] != data[i + count] && p.byte_pattern.data[count] != REGEX_SKIP) {
-                    break;
-                }
-                count++;
+        if (!patch.apply_match(title.batch, e.pattern, module.base_address + e.offset, data)) {
+            return false;
+        }
+        patch.state[e.pattern].match_addr = module.base_address + e.offset;
+        resolve_pattern(title, e.pattern);
+        unresolved &= ~(1U << e.pattern);
+    }
+
+    // the rest wasn't found in the same code
+    for (; unresolved; unresolved &= unresolved - 1) {
+        resolve_pattern(title, std::countr_zero(unresolved));
+    }
+    return true;
+}
+
+// searches for pattern i around offset in the module, nearest first, widening the window on a miss.
+// returns true if the pattern was resolved, otherwise it's left to the scan
+auto apply_hint(ScanPlan::Title& title, TitleMemory& mem, std::span<u8> buffer, u8 i, const LoaderModuleInfo& module, u32 offset, u32 radius) -> bool {
+    auto& patch = *title.patch;
+    const auto& p = patch.patterns[i];
+    const u32 size = p.byte_pattern.size;
+
+    // patterns are only ever at aligned offsets
+    if (patch.state[i].result != PatchResult::NOT_FOUND || offset % 4 || offset + size > module.size) {
+        return false;
+    }
+
+    u32 checked{}; // distance from offset that has been searched
+    for (radius = std::clamp(radius & ~3U, 4U, HINT_MAX_RADIUS);; radius = std::min(radius * 4, HINT_MAX_RADIUS)) {
+        const u64 begin = offset - std::min(offset, radius);
+        const u64 end = std::min<u64>(offset + radius + size, module.size);
+        if (!mem.read(buffer.data(), module.base_address + begin, end - begin)) {
+            return false;
+        }
+        patch.bytes_read += end - begin;
+
+        const auto check = [&](u64 at) -> bool {
+            const auto data = buffer.data() + (at - begin);
+            if (at + size > end || !pattern_match(p.byte_pattern, data) || !patch.apply_match(title.batch, i, module.base_address + at, data)) {
+                return false;
             }
 
-            // if we have found a matching pattern
-            if (count == p.byte_pattern.size) {
-                // fetch the instruction
-                u32 inst{};
-                const auto inst_offset = i + p.inst_offset;
-                std::memcpy(&inst, data + inst_offset, sizeof(inst));
-
-                // check if the instruction is the one that we want
-                if (p.cond(inst)) {
-                    const auto patch_data = p.patch(inst);
-                    const auto patch_offset = addr + inst_offset + p.patch_offset;
-
-                    // todo: log failed writes, although this should in theory never fail
-                    if (R_FAILED(svcWriteDebugProcessMemory(handle, &patch_data, patch_offset, patch_data.size))) {
-                        p.result = PatchResult::FAILED_WRITE;
-                    } else {
-                        p.result = PatchResult::PATCHED_SYSDOCK;
-                    }
-                    // move onto next pattern
-                    break;
-                } else if (p.applied(data + inst_offset + p.patch_offset, inst)) {
-                    // patch already applied by some other software
-                    p.result = PatchResult::PATCHED_FILE;
-                    break;
-                }
+            patch.state[i].match_addr = module.base_address + at;
+            resolve_pattern(title, i);
+            return true;
+        };
+
+        // only what the last window didn't cover, after then before offset
+        for (u64 d = checked; d <= radius; d += 4) {
+            if (check(offset + d) || (d && d <= offset && check(offset - d))) {
+                return true;
             }
         }
+
+        checked = radius + 4;
+        if (radius == HINT_MAX_RADIUS || (!begin && end == module.size)) {
+            return false;
+        }
     }
 }
 
-auto apply_patch(PatchEntry& patch) -> bool {
-    Handle handle{};
-    DebugEventInfo event_info{};
+// searches around the offsets the patterns had in the old builds of the modules, as kept in the
+// offset cache, after an update and before the title is scanned
+void apply_hints(ScanPlan::Title& title, TitleMemory& mem, std::span<u8> buffer, std::span<const LoaderModuleInfo> modules) {
+    const auto& patch = *title.patch;
 
-    u64 pids[0x50]{};
-    s32 process_count{};
-    constexpr u64 overlap_size = 0x4f;
-    static u8 buffer[READ_BUFFER_SIZE + overlap_size];
+    for (const auto& e : std::span{offset_cache.entries, offset_cache.count}) {
+        if (e.title_id == patch.title_id && e.pattern < patch.patterns.size() && e.module < modules.size()) {
+            apply_hint(title, mem, buffer, e.pattern, modules[e.module], e.offset, HINT_RADIUS);
+        }
+    }
+}
 
-    std::memset(buffer, 0, sizeof(buffer));
+// records where the patterns of the title were resolved, and the fingerprint of a complete scan
+void update_offset_cache(const ScanPlan::Title& title) {
+    const auto& patch = *title.patch;
+    const std::span<const LoaderModuleInfo> modules{title.modules, static_cast<size_t>(title.module_count)};
+    bool recorded = true; // every resolved pattern has its entry
 
-    // skip if version isn't valid
-    if (VERSION_SKIP &&
-        ((patch.min_fw_ver && patch.min_fw_ver > FW_VERSION) ||
-        (patch.max_fw_ver && patch.max_fw_ver < FW_VERSION))) {
-        for (auto& p : patch.patterns) {
-            p.result = PatchResult::SKIPPED;
+    for (u8 i = 0; i < patch.patterns.size(); i++) {
+        const auto addr = patch.state[i].match_addr;
+        if (!addr) {
+            continue;
+        }
+
+        const auto module = std::find_if(modules.begin(), modules.end(), [addr](const auto& m) {
+            return addr >= m.base_address && addr - m.base_address < m.size;
+        });
+        if (module == modules.end()) {
+            recorded = false;
+            continue;
+        }
+
+        OffsetCache::Entry entry{};
+        entry.title_id = patch.title_id;
+        std::memcpy(entry.build_id, module->build_id, sizeof(entry.build_id));
+        entry.offset = addr - module->base_address;
+        entry.pattern = i;
+        entry.module = module - modules.begin();
+
+        auto cached = std::find_if(offset_cache.entries, offset_cache.entries + offset_cache.count, [&](const auto& e) {
+            return e.title_id == entry.title_id && e.pattern == entry.pattern;
+        });
+        if (cached == offset_cache.entries + offset_cache.count) {
+            if (offset_cache.count == OffsetCache::MAX_ENTRIES) {
+                recorded = false;
+                continue;
+            }
+            offset_cache.count++;
+        } else if (!std::memcmp(cached, &entry, sizeof(entry))) {
+            continue;
+        }
+
+        *cached = entry;
+        offset_cache_dirty = true;
+    }
+
+    // without the entries, apply_fingerprint() would take the patterns for not found
+    if (!title.searched || !recorded) {
+        return;
+    }
+
+    auto scan = find_scan(patch.title_id);
+    if (!scan) {
+        scan = find_scan(0);
+    }
+    if (scan && (scan->title_id != patch.title_id || scan->fingerprint != title.fingerprint || scan->searched != title.searched)) {
+        *scan = { patch.title_id, title.fingerprint, title.searched };
+        offset_cache_dirty = true;
+    }
+}
+
+// finds the pid of every title in the plan.
+// pm:dmnt knows the pid of each title, otherwise every process is attached to once to read its
+// program id. the handle is closed right away, so that no title stays suspended while the ones
+// before it are patched, apply_patch() attaches again only when it gets to the title.
+void find_pids(ScanPlan& plan) {
+    bool missing{};
+    for (auto& title : std::span{plan.titles, plan.count}) {
+        if (!HAS_PMDMNT || R_FAILED(pmdmntGetProcessId(&title.pid, title.patch->title_id))) {
+            title.pid = 0;
+            missing = true;
         }
-        return true;
     }
 
+    if (!missing) {
+        return;
+    }
+
+    u64 pids[0x50]{};
+    s32 process_count{};
     if (R_FAILED(svcGetProcessList(&process_count, pids, 0x50))) {
-        return false;
+        return;
     }
 
     for (s32 i = 0; i < (process_count - 1); i++) {
-        if (R_SUCCEEDED(svcDebugActiveProcess(&handle, pids[i])) &&
-            R_SUCCEEDED(svcGetDebugEvent(&event_info, handle)) &&
-            patch.title_id == event_info.info.create_process.program_id) {
-            MemoryInfo mem_info{};
-            u64 addr{};
-            u32 page_info{};
-
-            for (;;) {
-                if (R_FAILED(svcQueryDebugProcessMemory(&mem_info, &page_info, handle, addr))) {
-                    break;
-                }
-                addr = mem_info.addr + mem_info.size;
+        Handle handle{};
+        DebugEventInfo event_info{};
+        if (R_FAILED(svcDebugActiveProcess(&handle, pids[i]))) {
+            continue;
+        }
 
-                // if addr=0 then we hit the reserved memory section
-                if (!addr) {
+        if (R_SUCCEEDED(svcGetDebugEvent(&event_info, handle))) {
+            for (auto& title : std::span{plan.titles, plan.count}) {
+                if (!title.pid && title.patch->title_id == event_info.info.create_process.program_id) {
+                    title.pid = pids[i];
                     break;
                 }
-                // skip memory that we don't want
-                if (!mem_info.size || (mem_info.perm & Perm_Rx) != Perm_Rx || ((mem_info.type & 0xFF) != MemType_CodeStatic)) {
-                    continue;
-                }
+            }
+        }
 
-                for (u64 sz = 0; sz < mem_info.size; sz += READ_BUFFER_SIZE - overlap_size) {
-                    const auto actual_size = std::min(READ_BUFFER_SIZE, mem_info.size - sz);
-                    if (R_FAILED(svcReadDebugProcessMemory(buffer + overlap_size, handle, mem_info.addr + sz, actual_size))) {
-                        break;
-                    } else {
-                        patcher(handle, buffer, actual_size + overlap_size, mem_info.addr + sz - overlap_size, patch.patterns);
-                        if (actual_size >= overlap_size) {
-                            memcpy(buffer, buffer + READ_BUFFER_SIZE, overlap_size);
-                            std::memset(buffer + overlap_size, 0, READ_BUFFER_SIZE);
-                        } else {
-                            const auto bytes_to_overlap = std::min<u64>(overlap_size, actual_size);
-                            memcpy(buffer, buffer + READ_BUFFER_SIZE + (actual_size - bytes_to_overlap), bytes_to_overlap);
-                            std::memset(buffer + bytes_to_overlap, 0, sizeof(buffer) - bytes_to_overlap);
-                        }
-                    }
-                }
+        svcCloseHandle(handle);
+    }
+}
+
+// split is whether the regions of the title can be scanned on every worker at once,
+// which is only the case if the workers aren't busy with other titles
+auto apply_patch(ScanPlan::Title& title, Scratch scratch, bool split) -> bool {
+    auto& patch = *title.patch;
+
+    if (!title.pid) {
+        return false;
+    }
+
+    // a process handle lets the title be searched without being attached to, which suspends it.
+    // this needs atmosphere's pm:dmnt extension
+    TitleMemory mem{title, 0};
+    if (HAS_PMDMNT) {
+        NcmProgramLocation location{};
+        CfgOverrideStatus status{};
+        if (R_FAILED(pmdmntAtmosphereGetProcessInfo(&mem.process, &location, &status, title.pid))) {
+            mem.process = 0;
+        }
+    }
+
+    if (!mem.process && !attach(title)) {
+        return false;
+    }
+
+    // every pattern that is looked for, by any of the steps below
+    u32 searched{};
+    for (const auto group : title.groups) {
+        searched |= group;
+    }
+
+    // without build ids the code regions are fingerprinted right away, as they stand in for the modules
+    bool fingerprinted{};
+    if (!HAS_LDRDMNT || R_FAILED(ldrDmntGetProcessModuleInfo(title.pid, title.modules, std::size(title.modules), &title.module_count))) {
+        title.module_count = 0;
+        fingerprinted = fingerprint_regions(title, mem, scratch.all(), true);
+    }
+    const std::span<const LoaderModuleInfo> module_span{title.modules, static_cast<size_t>(title.module_count)};
+
+    // the patterns are checked at their known offsets, then at the offsets of the last boot.
+    // if anything is left, the code is fingerprinted to see if the last scan can stand in for this one,
+    // otherwise the patterns are searched for around their offsets in the old builds, before scanning for the rest
+    apply_offset_db(title, mem, module_span);
+    apply_cached(title, mem, module_span);
+    if (!title.scanner.done() && !fingerprinted) {
+        fingerprinted = fingerprint_regions(title, mem, scratch.all(), false);
+    }
+    if (fingerprinted && !title.scanner.done()) {
+        apply_fingerprint(title, mem, module_span);
+    }
+    apply_hints(title, mem, scratch.all(), module_span);
+
+    MemoryInfo mem_info{};
+    u64 addr{};
+    bool complete = true; // every region was scanned until the patterns were resolved
+
+    for (;;) {
+        if (!mem.query(mem_info, addr)) {
+            complete = false;
+            break;
+        }
+        addr = mem_info.addr + mem_info.size;
+
+        // if addr=0 then we hit the reserved memory section
+        if (!addr) {
+            break;
+        }
+        // skip memory that we don't want
+        if (!mem_info.size || (mem_info.perm & Perm_Rx) != Perm_Rx || ((mem_info.type & 0xFF) != MemType_CodeStatic)) {
+            continue;
+        }
+
+        // once everything is resolved, only keep walking the regions to log the code size
+        patch.code_size += mem_info.size;
+        if (title.scanner.done()) {
+            continue;
+        }
+
+        // scan the region in place if it can be mapped, otherwise copy it out
+        u64 read{};
+        MappedSource mapped{};
+        if (mem.process && mapped.map(mem.process, mem_info.addr, mem_info.size)) {
+            if (split && mem_info.size >= SPLIT_MIN_SIZE) {
+                read = patcher_parallel(title, mapped);
+            } else {
+                read = patcher(title, mapped, mem_info.addr);
             }
-            svcCloseHandle(handle);
-            return true;
-        } else if (handle) {
-            svcCloseHandle(handle);
-            handle = 0;
+            mapped.unmap();
+        } else if (attach(title)) {
+            DebugReadSource source{title.handle, mem_info.addr, mem_info.size, scratch};
+            read = patcher(title, source, mem_info.addr);
+        }
+
+        patch.bytes_read += read;
+        if (read < mem_info.size && !title.scanner.done()) {
+            complete = false;
         }
     }
 
-    return false;
+    // what was found in code with this fingerprint, for the next boot
+    if (fingerprinted && complete) {
+        title.searched = searched;
+    }
+
+    // only now does the title have to be attached, for as short as possible.
+    // if that fails, the writes fail and the patterns are marked as such
+    if (title.batch.count) {
+        attach(title);
+        write_batch(title.handle, title.batch, patch.state);
+    }
+    detach(title);
+
+    if (mem.process) {
+        svcCloseHandle(mem.process);
+    }
+    return true;
 }
 
 // creates a directory, non-recursive!
 auto create_dir(const char* path) -> bool {
     Result rc{};
-    FsFileSystem fs{};
+    FsFileSystem own_fs{};
     char path_buf[FS_MAX_PATH]{};
 
-    if (R_FAILED(fsOpenSdCardFileSystem(&fs))) {
+    const auto fs = ini_fs_open(&own_fs);
+    if (!fs) {
         return false;
     }
 
     strcpy(path_buf, path);
-    rc = fsFsCreateDirectory(&fs, path_buf);
-    fsFsClose(&fs);
+    rc = fsFsCreateDirectory(fs, path_buf);
+    ini_fs_close(fs);
     return R_SUCCEEDED(rc);
 }
 
-// same as ini_get but writes out the default value instead
-auto ini_load_or_write_default(const char* section, const char* key, long _default, const char* path) -> long {
-    if (!ini_haskey(section, key, path)) {
-        ini_putl(section, key, _default, path);
+// same as ini_get but adds the default value instead, written out by IniTable::save()
+auto ini_load_or_write_default(IniTable& ini, const char* section, const char* key, long _default) -> long {
+    if (!ini.has_key(section, key)) {
+        ini.add(section, key, _default);
         return _default;
     } else {
-        return ini_getbool(section, key, _default, path);
+        return ini.get_bool(section, key, _default);
     }
 }
 
@@ -505,35 +1285,46 @@ void keygen_to_str(char* s, u8 keygen) {
 int main(int argc, char* argv[]) {
     constexpr auto ini_path = "/config/sys-dock/config.ini";
     constexpr auto log_path = "/config/sys-dock/log.ini";
+    constexpr auto cache_path = "/config/sys-dock/offsets.bin";
+    constexpr auto db_path = "/config/sys-dock/offset_db.bin";
 
     create_dir("/config/");
     create_dir("/config/sys-dock/");
     ini_remove(log_path);
 
+    // the config is read once, and only written back if any key was missing.
+    // static as the main thread only has a small stack
+    static IniTable config;
+    config.load(ini_path);
+
     // load options
-    const auto patch_sysmmc = ini_load_or_write_default("options", "patch_sysmmc", 1, ini_path);
-    const auto patch_emummc = ini_load_or_write_default("options", "patch_emummc", 1, ini_path);
-    const auto enable_logging = ini_load_or_write_default("options", "enable_logging", 1, ini_path);
-    VERSION_SKIP = ini_load_or_write_default("options", "version_skip", 1, ini_path);
+    const auto patch_sysmmc = ini_load_or_write_default(config, "options", "patch_sysmmc", 1);
+    const auto patch_emummc = ini_load_or_write_default(config, "options", "patch_emummc", 1);
+    const auto enable_logging = ini_load_or_write_default(config, "options", "enable_logging", 1);
+    VERSION_SKIP = ini_load_or_write_default(config, "options", "version_skip", 1);
+    PARALLEL = ini_load_or_write_default(config, "options", "parallel", 0);
 
     // load patch toggles
     for (auto& patch : patches) {
-        for (auto& p : patch.patterns) {
-            p.enabled = ini_load_or_write_default(patch.name, p.config_key, p.enabled, ini_path);
-            if (!p.enabled) {
-                p.result = PatchResult::DISABLED;
+        for (u8 i = 0; i < patch.patterns.size(); i++) {
+            auto& state = patch.state[i];
+            state.enabled = ini_load_or_write_default(config, patch.name, patch.patterns[i].config_key, patch.patterns[i].enabled);
+            if (!state.enabled) {
+                state.result = PatchResult::DISABLED;
             }
         }
     }
+    config.save(ini_path);
 
     for (auto& patch : patches) {
-        for (auto& p : patch.patterns) {
-            if (p.mutual_exclusivity_group < 0 || !p.enabled) continue;
-            for (auto& q : patch.patterns) {
-                if (&q == &p) break;
-                if (q.mutual_exclusivity_group == p.mutual_exclusivity_group && q.enabled) {
-                    p.enabled = false;
-                    p.result = PatchResult::DISABLED;
+        for (u8 i = 0; i < patch.patterns.size(); i++) {
+            const auto& p = patch.patterns[i];
+            auto& state = patch.state[i];
+            if (p.mutual_exclusivity_group < 0 || !state.enabled) continue;
+            for (u8 j = 0; j < i; j++) {
+                if (patch.patterns[j].mutual_exclusivity_group == p.mutual_exclusivity_group && patch.state[j].enabled) {
+                    state.enabled = false;
+                    state.result = PatchResult::DISABLED;
                     break;
                 }
             }
@@ -557,21 +1348,49 @@ int main(int argc, char* argv[]) {
     const auto ticks_start = armGetSystemTick();
 
     if (enable_patching) {
-        for (auto& patch : patches) {
-            apply_patch(patch);
+        // static as the main thread only has a small stack
+        static ScanPlan plan;
+        build_scan_plan(plan);
+        find_pids(plan);
+        load_offset_db(db_path);
+        load_offset_cache(cache_path);
+
+        const std::span titles{plan.titles, plan.count};
+        if (PARALLEL && titles.size() > 1) {
+            // a title per worker
+            parallel_for(titles.size(), [&](u32 i, u32 worker) {
+                apply_patch(titles[i], Scratch::of(worker, WORKER_COUNT), false);
+            });
+        } else {
+            // the regions of each title are split between the workers instead
+            for (auto& title : titles) {
+                apply_patch(title, Scratch::of(0, 1), PARALLEL);
+            }
         }
+
+        // the cache is shared by the titles, so it's only updated once they're all done
+        for (const auto& title : titles) {
+            update_offset_cache(title);
+        }
+
+        save_offset_cache(cache_path);
     }
 
     const auto ticks_end = armGetSystemTick();
     const auto diff_ns = armTicksToNs(ticks_end) - armTicksToNs(ticks_start);
 
     if (enable_logging) {
+        // the whole log is built in memory and written at once.
+        // static as the main thread only has a small stack
+        static IniWriter log;
+
         for (auto& patch : patches) {
-            for (auto& p : patch.patterns) {
+            for (u8 i = 0; i < patch.patterns.size(); i++) {
+                auto& state = patch.state[i];
                 if (!enable_patching) {
-                    p.result = PatchResult::SKIPPED;
+                    state.result = PatchResult::SKIPPED;
                 }
-                ini_puts(patch.name, p.patch_name, patch_result_to_str(p.result), log_path);
+                log.put(patch.name, patch.patterns[i].patch_name, patch_result_to_str(state.result));
             }
         }
 
@@ -598,17 +1417,33 @@ int main(int argc, char* argv[]) {
         // defined in the Makefile
         #define DATE (DATE_DAY "." DATE_MONTH "." DATE_YEAR " " DATE_HOUR ":" DATE_MIN ":" DATE_SEC)
 
-        ini_puts("stats", "version", VERSION_WITH_HASH, log_path);
-        ini_puts("stats", "build_date", DATE, log_path);
-        ini_puts("stats", "fw_version", fw_version, log_path);
-        ini_puts("stats", "ams_version", ams_version, log_path);
-        ini_puts("stats", "ams_target_version", ams_target_version, log_path);
-        ini_puts("stats", "ams_keygen", ams_keygen, log_path);
-        ini_puts("stats", "ams_hash", ams_hash, log_path);
-        ini_putl("stats", "is_emummc", emummc, log_path);
-        ini_putl("stats", "heap_size", INNER_HEAP_SIZE, log_path);
-        ini_putl("stats", "buffer_size", READ_BUFFER_SIZE, log_path);
-        ini_puts("stats", "patch_time", patch_time, log_path);
+        log.put("stats", "version", VERSION_WITH_HASH);
+        log.put("stats", "build_date", DATE);
+        log.put("stats", "fw_version", fw_version);
+        log.put("stats", "ams_version", ams_version);
+        log.put("stats", "ams_target_version", ams_target_version);
+        log.put("stats", "ams_keygen", ams_keygen);
+        log.put("stats", "ams_hash", ams_hash);
+        log.put("stats", "is_emummc", emummc);
+        log.put("stats", "heap_size", INNER_HEAP_SIZE);
+        log.put("stats", "buffer_size", READ_BUFFER_SIZE);
+        log.put("stats", "patch_time", patch_time);
+
+        // how much of each title's code had to be read, and how long each title was suspended
+        for (auto& patch : patches) {
+            char key[64]{};
+            std::strcpy(key, patch.name);
+            std::strcat(key, "_bytes_read");
+            log.put("stats", key, patch.bytes_read);
+            std::strcpy(key, patch.name);
+            std::strcat(key, "_code_size");
+            log.put("stats", key, patch.code_size);
+            std::strcpy(key, patch.name);
+            std::strcat(key, "_attach_us");
+            log.put("stats", key, patch.attach_ns / 1000ULL);
+        }
+
+        log.save(log_path);
     }
 
     // note: sysmod exits here.
@@ -670,15 +1505,30 @@ void __appInit(void) {
         splExit();
     }
 
+    // used to find the pids of the titles, falls back to attaching to every process
+    HAS_PMDMNT = R_SUCCEEDED(pmdmntInitialize());
+    // used to find the modules of the titles for the offset cache, the code regions stand in for them otherwise
+    HAS_LDRDMNT = R_SUCCEEDED(ldrDmntInitialize());
+
     if (R_FAILED(rc = fsInitialize()))
         fatalThrow(rc);
 
+    // one session of the sd card for every file, each file opens its own if this fails
+    ini_fs_init();
+
     // Close the service manager session.
     smExit();
 }
 
 // Service deinitialization.
 void __appExit(void) {
+    ini_fs_exit();
     fsExit();
+    if (HAS_PMDMNT) {
+        pmdmntExit();
+    }
+    if (HAS_LDRDMNT) {
+        ldrDmntExit();
+    }
 }
 } // extern "C"
@@ -0,0 +1,272 @@
+#pragma once
+
+// the patterns that are searched for in each title, and what is patched where they're found.
+// like scanner.hpp this doesn't depend on libnx, so that the bench (see bench/) runs the same
+// tables and dispatch as the sysmodule.
+
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <utility> // std::index_sequence
+#include "scanner.hpp"
+
+#if !defined(MAKEHOSVERSION)
+// same as libnx
+#define MAKEHOSVERSION(_major,_minor,_micro) (((u32)(_major) << 16) | ((u32)(_minor) << 8) | (u32)(_micro))
+#endif
+
+namespace {
+
+constexpr u32 FW_VER_ANY = 0x0;
+
+struct PatchData {
+    constexpr PatchData(const char* s) {
+        str2hex(s, data, size);
+    }
+
+    template<typename T>
+    constexpr PatchData(T v) {
+        for (u32 i = 0; i < sizeof(T); i++) {
+            data[size++] = v & 0xFF;
+            v >>= 8;
+        }
+    }
+
+    constexpr auto cmp(const void* _data) -> bool {
+        return !std::memcmp(data, _data, size);
+    }
+
+    u8 data[24]{}; // reasonable max patch length, adjust as needed
+    u8 size{};
+};
+
+enum class PatchResult {
+    NOT_FOUND,
+    SKIPPED,
+    DISABLED,
+    PATCHED_FILE,
+    PATCHED_SYSDOCK,
+    FAILED_WRITE,
+};
+
+struct Patterns {
+    const char* patch_name; // name of patch (unique per variant, used for logging)
+    const char* config_key; // config.ini key (shared among variants of the same logical patch)
+    const PatternData byte_pattern; // the pattern to search
+
+    // the instruction and the patch have to be within the byte pattern
+    const s32 inst_offset; // instruction offset relative to byte pattern
+    const s32 patch_offset; // patch offset relative to inst_offset
+
+    bool (*const cond)(u32 inst); // check condition of the instruction
+    PatchData (*const patch)(u32 inst); // the patch data to be applied
+    bool (*const applied)(const u8* data, u32 inst); // check to see if patch already applied
+
+    bool enabled; // default, controlled by config.ini (see PatternState)
+    const s32 mutual_exclusivity_group{-1}; // patches with the same group (>= 0) are mutually exclusive
+
+    const u32 min_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+    const u32 max_fw_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+    const u32 min_ams_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+    const u32 max_ams_ver{FW_VER_ANY}; // set to FW_VER_ANY to ignore
+};
+
+// the part of a pattern that changes at runtime, the pattern tables themselves are constexpr
+struct PatternState {
+    bool enabled; // controlled by config.ini
+    PatchResult result{PatchResult::NOT_FOUND};
+    u64 match_addr{}; // where the pattern was resolved, 0 if it wasn't
+};
+
+// the patches of a title, written together once the title has been searched
+struct PatchBatch {
+    static constexpr u32 MAX_WRITES = MultiScanner::MAX_PATTERNS;
+    static constexpr u32 MAX_WRITE_SIZE = 64; // writes that touch are merged, up to this size
+
+    struct Write {
+        u64 addr;
+        u8 data[MAX_WRITE_SIZE];
+        u8 original[MAX_WRITE_SIZE]; // to undo the write
+        u8 size;
+        u32 patterns; // bit per index into PatchEntry::patterns
+    };
+
+    Write writes[MAX_WRITES];
+    u8 count;
+};
+
+// calls fn.template operator()<I>() with I = i, so that the pattern at i is a constant in fn
+template<size_t Size, typename F>
+auto dispatch(u8 i, F&& fn) -> bool {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+        bool result{};
+        ((i == I && ((result = fn.template operator()<I>()), true)) || ...);
+        return result;
+    }(std::make_index_sequence<Size>{});
+}
+
+// everything that depends on the pattern table of a title, instantiated for the table so that
+// the cond, patch and applied of every pattern are inlined instead of called through pointers
+template<const auto& Table>
+struct PatternTable {
+    static constexpr u8 size = std::size(Table);
+    static_assert(size <= MultiScanner::MAX_PATTERNS);
+
+    static inline PatternState state[size]{};
+
+    // index of the first pattern with the same bytes, they're only searched for once
+    static constexpr auto canonical = [] {
+        std::array<u8, size> c{};
+        for (u8 i = 0; i < size; i++) {
+            for (u8 j = 0; j <= i; j++) {
+                if (Table[j].byte_pattern == Table[i].byte_pattern) {
+                    c[i] = j;
+                    break;
+                }
+            }
+        }
+        return c;
+    }();
+
+    // queues the patch of pattern id found at addr, match points to a copy of its bytes.
+    // returns true if the pattern is resolved
+    static auto apply_match(PatchBatch& batch, u8 id, u64 addr, const u8* match) -> bool {
+        return dispatch<size>(id, [&]<size_t I>() -> bool {
+            constexpr auto& p = Table[I];
+            auto& s = state[I];
+
+            // fetch the instruction
+            u32 inst{};
+            std::memcpy(&inst, match + p.inst_offset, sizeof(inst));
+
+            // check if the instruction is the one that we want
+            if (p.cond(inst)) {
+                const auto patch_data = p.patch(inst);
+
+                // there's a write for every pattern at most, so this never fills up
+                auto& w = batch.writes[batch.count++];
+                w.addr = addr + p.inst_offset + p.patch_offset;
+                w.size = patch_data.size;
+                w.patterns = 1U << id;
+                std::memcpy(w.data, patch_data.data, patch_data.size);
+                std::memcpy(w.original, match + p.inst_offset + p.patch_offset, patch_data.size);
+
+                // until the batch is written, see write_batch()
+                s.result = PatchResult::PATCHED_SYSDOCK;
+                // move onto next pattern
+                return true;
+            } else if (p.applied(match + p.inst_offset + p.patch_offset, inst)) {
+                // patch already applied by some other software
+                s.result = PatchResult::PATCHED_FILE;
+                return true;
+            }
+
+            return false;
+        });
+    }
+};
+
+template<const auto& Table>
+constexpr PatternTable<Table> pattern_table{};
+
+constexpr auto movz_cond(u32 inst) -> bool {
+    return (inst >> 24) == 0x52; // MOVZ Wn, #imm
+}
+
+constexpr auto strb_cond(u32 inst) -> bool {
+    return (inst >> 24) == 0x39; // STRB Wt, [Xn, #imm]
+}
+
+constexpr auto tbnz_cond(u32 inst) -> bool {
+    return (inst >> 24) == 0x37; // TBNZ Rt, #imm, label
+}
+
+constexpr auto cbz_cond(u32 inst) -> bool {
+    return (inst >> 24) == 0x34; // CBZ Rt, label
+}
+
+constexpr auto bcond_cond(u32 inst) -> bool {
+    return (inst >> 24) == 0x54; // B.cond label
+}
+
+constexpr auto bcond_or_tbnz_cond(u32 inst) -> bool {
+    return bcond_cond(inst) || tbnz_cond(inst);
+}
+
+constexpr auto bic_w8_w8_wm_lsr2_cond(u32 inst) -> bool {
+    // wildcard only Rm (bits 20..16)
+    return (inst & 0xFFE0FFFFu) == 0x0A600908u; // BIC w8, w8, Rm, lsr #2
+}
+
+// to view patches, use https://armconverter.com/?lock=arm64
+constexpr PatchData nop_patch_data{ "0x1F2003D5" };
+constexpr PatchData nop5_patch_data{ "0x1F2003D51F2003D51F2003D51F2003D51F2003D5" };
+constexpr PatchData nop6_patch_data{ "0x1F2003D51F2003D51F2003D51F2003D51F2003D51F2003D5" };
+constexpr PatchData mov_w9_0x406_patch_data{ "0xC9808052" };
+constexpr PatchData mov_w20_0x406_patch_data{ "0xD4808052" };
+constexpr PatchData mov_w8_2_patch_data{ "0x48008052" };
+
+constexpr auto nop_patch(u32 inst) -> PatchData { return nop_patch_data; }
+constexpr auto nop5_patch(u32 inst) -> PatchData { return nop5_patch_data; }
+constexpr auto nop6_patch(u32 inst) -> PatchData { return nop6_patch_data; }
+constexpr auto mov_w9_0x406_patch(u32 inst) -> PatchData { return mov_w9_0x406_patch_data; }
+constexpr auto mov_w20_0x406_patch(u32 inst) -> PatchData { return mov_w20_0x406_patch_data; }
+constexpr auto mov_w8_2_patch(u32 inst) -> PatchData { return mov_w8_2_patch_data; }
+
+constexpr auto nop_applied(const u8* data, u32 inst) -> bool { return nop_patch(inst).cmp(data); }
+constexpr auto nop5_applied(const u8* data, u32 inst) -> bool { return nop5_patch(inst).cmp(data); }
+constexpr auto nop6_applied(const u8* data, u32 inst) -> bool { return nop6_patch(inst).cmp(data); }
+constexpr auto mov_w9_0x406_applied(const u8* data, u32 inst) -> bool { return mov_w9_0x406_patch(inst).cmp(data); }
+constexpr auto mov_w20_0x406_applied(const u8* data, u32 inst) -> bool { return mov_w20_0x406_patch(inst).cmp(data); }
+constexpr auto mov_w8_2_applied(const u8* data, u32 inst) -> bool { return mov_w8_2_patch(inst).cmp(data); }
+
+constexpr Patterns nvservices_patterns[] = {
+    // 79 01 00 34  CBZ     W25, loc_7100042540     <-- nop
+    // 2A 05 91 52  MOV     W10, #0x48829           <-- nop
+    // 8A 00 A0 72                                  <-- nop
+    // FF 02 0A 6B  CMP     W23, W10                <-- nop
+    // E3 00 00 54  B.CC    loc_7100042540          <-- nop
+    // 69 EE 0C 39  STRB    W9, [X19,#(g_dp_lane_count)]
+    { "21.0.0+ no_lane_downgrade", "no_lane_downgrade", "0x...34.059152.00a072...6b...54.ee0c39", 0, 0, cbz_cond, nop5_patch, nop5_applied, false, -1, MAKEHOSVERSION(21,0,0), FW_VER_ANY},
+    // same as above, but there's an extra LDUR after the CBZ
+    { "17.0.0-17.0.1 no_lane_downgrade", "no_lane_downgrade", "0x...34.....059152.00a072...6b...54.ee0c39", 0, 0, cbz_cond, nop6_patch, nop6_applied, false, -1, MAKEHOSVERSION(17,0,0), MAKEHOSVERSION(17,0,1)},
+    // 2A 05 91 52  MOV     W10, #0x48829
+    // 8A 00 A0 72
+    // FF 02 0A 6B  CMP     W23, W10
+    // 42 00 00 54  B.CS    loc_71000405C0
+    // 49 00 80 52  MOV     W9, #2                  <-- nop
+    // 69 EE 0C 39  STRB    W9, [X19,#(g_dp_lane_count)]
+    { "11.0.0-16.1.0 no_lane_downgrade", "no_lane_downgrade", "0x.059152.00a072...6b...54.008052.ee0c39", 16, 0, movz_cond, nop_patch, nop_applied, false, -1, MAKEHOSVERSION(11,0,0), MAKEHOSVERSION(16,1,0)},
+    // same as above, just because of no_lane_downgrade_2 we need to put next FW versions in separate table
+    { "18.0.0-20.5.0 no_lane_downgrade", "no_lane_downgrade", "0x.059152.00a072...6b...54.008052.ee0c39", 16, 0, movz_cond, nop_patch, nop_applied, false, -1, MAKEHOSVERSION(18,0,0), MAKEHOSVERSION(20,5,0)},
+    // 61 00 00 54  B.NE    loc_71000427B4
+    // 48 01 80 52  MOV     W8, #0xA
+    // 68 E6 0C 39  STRB    W8, [X19,#(g_dp_current_link_bw)]   <-- nop
+    // 61 E6 0C 91  ADD     X1, X19, #0x339
+    // 62 EA 0C 91  ADD     X2, X19, #0x33A
+    { "no_bw_downgrade", "no_bw_downgrade", "0x.....018052.e60c39..0c91..0c91", 8, 0, strb_cond, nop_patch, nop_applied, false, 0, MAKEHOSVERSION(11,0,0), FW_VER_ANY},
+    // same pattern as above, except we nop the B.NE and force the STRB
+    { "force_bw_downgrade", "force_bw_downgrade", "0x.....018052.e60c39..0c91..0c91", 0, 0, bcond_or_tbnz_cond, nop_patch, nop_applied, false, 0, MAKEHOSVERSION(11,0,0), FW_VER_ANY},
+    // 28 00 80 52  MOV     W8, #1
+    // 08 09 79 0A  BIC     W8, W8, W25, LSR#2      <-- MOV W8, #2
+    { "11.0.0-14.1.2 force_full_render_pass", "force_full_render_pass", "0x280080520809[60/E0]0A", 4, 0, bic_w8_w8_wm_lsr2_cond, mov_w8_2_patch, mov_w8_2_applied, false, -1, MAKEHOSVERSION(11,0,0), MAKEHOSVERSION(14,1,2) },
+    // 08 09 79 0A  BIC     W8, W8, W25, LSR#2      <-- MOV W8, #2
+    // E0 03 1A AA  MOV     X0, X26
+    { "15.0.0+ force_full_render_pass", "force_full_render_pass", "0x0809[60/E0]0AE003[00/E0]AA", 0, 0, bic_w8_w8_wm_lsr2_cond, mov_w8_2_patch, mov_w8_2_applied, false, -1, MAKEHOSVERSION(15,0,0), FW_VER_ANY },
+};
+
+constexpr Patterns usb_patterns[] = {
+    // C0 03 5F D6  RET
+    // D4 00 81 52  MOV     W20, #0x806             <-- 0x406
+    { "15.0.0+ force_dp_mode_c", "force_dp_mode_c", "0xC0035FD6D4008152", 4, 0, movz_cond, mov_w20_0x406_patch, mov_w20_0x406_applied, false, -1, MAKEHOSVERSION(15,0,0), FW_VER_ANY},
+    // C0 10 84 52  MOV     W0, #0x2086
+    // DC FF FF 17  B       loc_7100054E38
+    // D4 00 81 52  MOV     W20, #0x806             <-- 0x406
+    { "12.0.0-14.1.2 force_dp_mode_c", "force_dp_mode_c", "0xC0108452....D4008152", 8, 0, movz_cond, mov_w20_0x406_patch, mov_w20_0x406_applied, false, -1, MAKEHOSVERSION(12,0,0), MAKEHOSVERSION(14,1,2)},
+    // 1F 01 0E 72  TST     W8, #0x40000
+    // C8 80 80 52  MOV     W8, #0x406
+    // C9 00 81 52  MOV     W9, #0x806              <-- 0x406
+    { "11.0.0-11.0.1 force_dp_mode_c", "force_dp_mode_c", "0x1F010E72C8808052C9008152", 8, 0, movz_cond, mov_w9_0x406_patch, mov_w9_0x406_applied, false, -1, MAKEHOSVERSION(11,0,0), MAKEHOSVERSION(11,0,1)},
+};
+
+} // namespace
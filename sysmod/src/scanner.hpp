@@ -0,0 +1,655 @@
+#pragma once
+
+// pattern parsing and the scanner used by patcher(), and the crc used to fingerprint code.
+// this header doesn't depend on libnx so that it can also be built on the host (see bench/).
+
+#include <cstddef>
+#include <cstring>
+#include <bit>
+#include <concepts>
+#include <utility> // std::unreachable
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SWITCH__)
+#include <switch/types.h>
+#else
+#include <cstdint>
+using u8 = std::uint8_t;
+using u16 = std::uint16_t;
+using u32 = std::uint32_t;
+using u64 = std::uint64_t;
+using s32 = std::int32_t;
+using s64 = std::int64_t;
+#endif
+
+namespace {
+
+// invalid string will cause a compile-time error, as std::unreachable() isn't a constant expression
+constexpr auto hexstr_2_nibble(char c) -> u8 {
+    if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+    if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    if (c >= '0' && c <= '9') { return c - '0'; }
+    std::unreachable();
+}
+
+// skip leading 0x (if any)
+constexpr auto skip_hex_prefix(const char* s) -> const char* {
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s += 2;
+    }
+    return s;
+}
+
+constexpr void str2hex(const char* s, u8* data, u8& size) {
+    s = skip_hex_prefix(s);
+
+    // parse and convert string
+    while (*s != '\0') {
+        data[size] |= hexstr_2_nibble(*s++) << 4;
+        data[size] |= hexstr_2_nibble(*s++) << 0;
+        size++;
+    }
+}
+
+// same as str2hex, but also outputs which bits of each byte have to match.
+// besides hex, a pattern can contain:
+// - '.' to skip a whole byte
+// - 'x' to skip a nibble, eg "6x"
+// - "[vv/mm]" for a byte where only the bits set in mm have to match vv, eg "[60/E0]"
+constexpr void str2pattern(const char* s, u8* data, u8* mask, u8& size) {
+    s = skip_hex_prefix(s);
+
+    // invalid string will cause a compile-time error, same as hexstr_2_nibble()
+    constexpr auto expect = [](const char*& s, char c) -> bool {
+        if (*s == c) { s++; return true; }
+        std::unreachable();
+    };
+
+    constexpr auto parse_nibble = [](const char*& s, u8& data, u8& mask, u32 shift) {
+        if (*s == 'x' || *s == 'X') {
+            s++;
+        } else {
+            data |= hexstr_2_nibble(*s++) << shift;
+            mask |= 0xF << shift;
+        }
+    };
+
+    // parse and convert string
+    while (*s != '\0') {
+        if (*s == '.') {
+            s++;
+        } else if (*s == '[') {
+            u8 byte_mask{};
+            s++;
+            data[size] |= hexstr_2_nibble(*s++) << 4;
+            data[size] |= hexstr_2_nibble(*s++) << 0;
+            expect(s, '/');
+            byte_mask |= hexstr_2_nibble(*s++) << 4;
+            byte_mask |= hexstr_2_nibble(*s++) << 0;
+            expect(s, ']');
+            data[size] &= byte_mask;
+            mask[size] = byte_mask;
+        } else {
+            parse_nibble(s, data[size], mask[size], 4);
+            parse_nibble(s, data[size], mask[size], 0);
+        }
+        size++;
+    }
+}
+
+// rough model of how common a byte value is in AArch64 code, from 1 (rare) to 3 (very common).
+// lane is the byte's position in the instruction, the top byte (lane 3) holds the opcode
+// while the lower bytes are mostly registers and small immediates.
+constexpr auto byte_frequency(u8 value, u32 lane) -> u8 {
+    if (lane == 3) {
+        switch (value) {
+            case 0xF9: case 0xB9: case 0x39: case 0x79: case 0xF8: case 0xB8: // LDR/STR
+            case 0xA9: case 0xA8: case 0x29: case 0x28: // LDP/STP
+            case 0x91: case 0xD1: case 0x11: case 0x51: // ADD/SUB imm
+            case 0xAA: case 0x2A: case 0x52: case 0x72: case 0xD2: case 0xF2: // MOV
+            case 0x94: case 0x97: case 0x14: case 0x17: case 0x54: case 0xD6: // branches
+            case 0x34: case 0x35: case 0xB4: case 0xB5: case 0x36: case 0x37: // CBZ/TBZ
+            case 0x71: case 0xF1: case 0x6B: case 0xEB: // CMP
+            case 0x90: case 0xB0: case 0xD0: case 0xF0: // ADRP
+                return 3;
+            case 0x12: case 0x92: case 0x0A: case 0x8A: case 0x1A: case 0x9A:
+            case 0x0B: case 0x8B: case 0x4B: case 0xCB: case 0x53: case 0xD3:
+                return 2;
+            default:
+                return 1;
+        }
+    }
+
+    switch (value) {
+        case 0x00: case 0xFF: case 0x03: case 0x1F: case 0xE0: case 0xE3:
+            return 3;
+        case 0x01: case 0x02: case 0x08: case 0x13: case 0x40: case 0x80: case 0xC0: case 0xF3: case 0xFD:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+constexpr u32 MAX_PATTERN_SIZE = 60; // reasonable max pattern length, adjust as needed
+
+// reads the (little endian) instruction at data, which doesn't need to be aligned
+inline auto load_inst(const u8* data) -> u32 {
+    u32 inst;
+    std::memcpy(&inst, data, sizeof(inst));
+    return inst;
+}
+
+// a pattern is matched a whole instruction at a time, skipped bits are 0 in mask.
+// patterns have to start at an instruction, as they are only searched for at aligned offsets.
+struct PatternData {
+    constexpr PatternData(const char* s) {
+        u8 data[sizeof(value)]{};
+        u8 data_mask[sizeof(value)]{};
+        str2pattern(s, data, data_mask, size);
+
+        words = (size + 3) / 4;
+        for (u8 i = 0; i < size; i++) {
+            value[i / 4] |= u32(data[i]) << (i % 4 * 8);
+            mask[i / 4] |= u32(data_mask[i]) << (i % 4 * 8);
+        }
+        find_anchor();
+        find_order();
+    }
+
+    u32 value[MAX_PATTERN_SIZE / 4]{};
+    u32 mask[MAX_PATTERN_SIZE / 4]{}; // bits of value that have to match
+    u8 size{}; // in bytes
+    u8 words{};
+    u8 anchor{}; // index of the rarest word, the scanner searches for this first
+    // the other words with fixed bits, rarest first, so that a wrong candidate is turned down
+    // after as few compares as possible. common opcodes and wildcard heavy words come last
+    u8 order[MAX_PATTERN_SIZE / 4]{};
+    u8 order_count{};
+
+    constexpr auto operator==(const PatternData&) const -> bool = default;
+
+private:
+    // how likely the word is to match by chance, lower is rarer.
+    // a skipped byte costs more than even the most common value
+    constexpr auto word_cost(u8 i) const -> u32 {
+        u32 cost = 1;
+        for (u32 lane = 0; lane < 4; lane++) {
+            const auto m = (mask[i] >> (lane * 8)) & 0xFF;
+            cost *= m == 0xFF ? byte_frequency(value[i] >> (lane * 8), lane) : (m ? 4 : 8);
+        }
+        return cost;
+    }
+
+    constexpr void find_anchor() {
+        u32 best_cost = ~0U;
+        for (u8 i = 0; i < words; i++) {
+            if (mask[i] && word_cost(i) < best_cost) {
+                best_cost = word_cost(i);
+                anchor = i;
+            }
+        }
+    }
+
+    constexpr void find_order() {
+        for (u8 i = 0; i < words; i++) {
+            if (i == anchor || !mask[i]) {
+                continue;
+            }
+
+            // insertion sort, equal costs stay left to right
+            u8 j = order_count++;
+            for (; j && word_cost(order[j - 1]) > word_cost(i); j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = i;
+        }
+    }
+};
+
+// checks if the pattern matches at the start of data, the anchor then the rest by order
+inline auto pattern_match(const PatternData& p, const u8* data) -> bool {
+    if ((load_inst(data + p.anchor * 4) & p.mask[p.anchor]) != p.value[p.anchor]) {
+        return false;
+    }
+    for (u32 k = 0; k < p.order_count; k++) {
+        const auto i = p.order[k];
+        if ((load_inst(data + i * 4) & p.mask[i]) != p.value[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// finds the candidates of every added pattern in a single pass over a stream of data,
+// such as a memory region that is read in pieces.
+// the data is searched for the anchor words of all patterns at once with simd,
+// and only the patterns of a matching anchor are compared, so the cost stays flat
+// no matter how many patterns have been added.
+// only instruction aligned offsets are searched, so each piece has to be a multiple of 4.
+// where MultiScanner::scan_source() gets the memory to scan from.
+// read() returns size bytes at offset, or nullptr on failure. the bytes have to stay valid
+// until the read after the next one, as a pattern can cross from one read into the next.
+// reads start at min_read() and double up to max_read(), so sources that copy can stop
+// early, while sources that map the memory can hand out all of it at once.
+template<typename T>
+concept MemorySource = requires(T& source, u64 offset, u64 size) {
+    { source.size() } -> std::convertible_to<u64>;
+    { source.min_read() } -> std::convertible_to<u64>;
+    { source.max_read() } -> std::convertible_to<u64>;
+    { source.read(offset, size) } -> std::same_as<const u8*>;
+};
+
+class MultiScanner {
+public:
+    static constexpr u8 MAX_PATTERNS = 32;
+
+#if defined(__ARM_NEON) || defined(__AVX2__) || defined(__SSE2__)
+    static constexpr bool HAS_SIMD = true;
+#else
+    static constexpr bool HAS_SIMD = false;
+#endif
+
+    // returns false if the scanner is full or the pattern has no fixed bits
+    auto add(const PatternData& pattern, u8 id) -> bool {
+        if (count == MAX_PATTERNS || !pattern.mask[pattern.anchor]) {
+            return false;
+        }
+
+        const Anchor anchor{ pattern.value[pattern.anchor], pattern.mask[pattern.anchor] };
+        entries[count++] = { anchor, pattern.value, pattern.mask, pattern.order, pattern.anchor, pattern.words, pattern.order_count, id };
+        update_anchors();
+        return true;
+    }
+
+    // drops the pattern, for when it was resolved without scanning
+    void remove(u8 id) {
+        for (u8 i = 0; i < count; i++) {
+            if (entries[i].id == id) {
+                entries[i] = entries[--count];
+                update_anchors();
+                return;
+            }
+        }
+    }
+
+    // drops every pattern, in place as the scanner is too big to be copied on a small stack
+    void clear() {
+        count = 0;
+        anchor_count = 0;
+        reset_stream();
+    }
+
+    // true once every added pattern has been resolved
+    auto done() const -> bool {
+        return !count;
+    }
+
+    // starts a new stream, the next piece given to scan() is at offset 0.
+    // candidates that didn't fit in the previous stream are dropped.
+    void reset_stream() {
+        prev = {};
+        offset = 0;
+    }
+
+    // scans the next piece of the stream, pieces are never copied.
+    // a pattern can cross from the previous piece into this one, so the previous piece has
+    // to stay untouched until this returns. every piece but the last has to be at least
+    // MAX_PATTERN_SIZE bytes, as a pattern can only cross one boundary.
+    //
+    // calls on_match(id, offset, match) for every candidate, where offset is relative to the
+    // start of the stream and match points to the whole pattern's bytes.
+    // candidates of a pattern are reported in order of offset.
+    // if on_match returns true, the pattern is resolved and won't be reported again.
+    template<bool UseSimd = HAS_SIMD, typename F>
+    void scan(const u8* data, size_t data_size, F&& on_match) {
+        cur = { data, data_size / 4 * 4, offset };
+
+        finish_prev(on_match);
+
+        const size_t words = cur.size / 4;
+        size_t i = 0;
+        if constexpr (UseSimd) {
+            for (; i + VECTOR_WORDS <= words && count; i += VECTOR_WORDS) {
+                for (auto hits = anchor_mask(data + i * 4); hits && count; hits &= hits - 1) {
+                    const auto word = i + (std::countr_zero(hits) >> MASK_SHIFT);
+                    check_anchors(word, load_inst(data + word * 4), on_match);
+                }
+            }
+        }
+
+        // scalar tail (or everything, without simd)
+        for (; i < words && count; i++) {
+            const auto inst = load_inst(data + i * 4);
+            for (u8 a = 0; a < anchor_count; a++) {
+                if ((inst & anchors[a].mask) == anchors[a].value) {
+                    check_anchors(i, inst, on_match);
+                    break;
+                }
+            }
+        }
+
+        prev = cur;
+        offset += cur.size;
+    }
+
+    // scans the whole source as one stream, until every pattern has been resolved.
+    // returns how much of the source was read
+    template<bool UseSimd = HAS_SIMD, MemorySource Source, typename F>
+    auto scan_source(Source& source, F&& on_match) -> u64 {
+        reset_stream();
+
+        u64 pos{};
+        u64 read_size = source.min_read();
+        while (pos < source.size() && !done()) {
+            const u64 actual_size = read_size < source.size() - pos ? read_size : source.size() - pos;
+            const auto data = source.read(pos, actual_size);
+            if (!data) {
+                break;
+            }
+
+            scan<UseSimd>(data, actual_size, on_match);
+            pos += actual_size;
+            read_size = read_size * 2 < source.max_read() ? read_size * 2 : source.max_read();
+        }
+
+        return pos;
+    }
+
+    // finds the first candidate of each pattern that starts in [begin, end) of data, so that
+    // the data can be split into ranges that are scanned in parallel, each with a copy of the scanner.
+    // data is read up to MAX_PATTERN_SIZE - 4 bytes past end, for the patterns starting right before it.
+    // first[id] is lowered to the offset of the pattern's candidate, if it has one in the range.
+    // every pattern is resolved by its first candidate, so the copy is used up afterwards.
+    template<bool UseSimd = HAS_SIMD>
+    void find_first(const u8* data, u64 data_size, u64 begin, u64 end, u64* first) {
+        const u64 stop = end + MAX_PATTERN_SIZE - 4 < data_size ? end + MAX_PATTERN_SIZE - 4 : data_size;
+        if (begin >= stop) {
+            return;
+        }
+
+        reset_stream();
+        scan<UseSimd>(data + begin, stop - begin, [&](u8 id, u64 offset, const u8*) {
+            // later candidates are always further in, so past end there's nothing left to find
+            if (begin + offset < end && begin + offset < first[id]) {
+                first[id] = begin + offset;
+            }
+            return true;
+        });
+    }
+
+#if defined(SCANNER_STATS)
+    // number of full pattern compares done so far, and of the words compared by them.
+    // only in the bench build (see bench/Makefile), so that the sysmodule doesn't count them
+    u64 candidates{};
+    u64 compares{};
+#endif
+
+private:
+#if defined(__ARM_NEON)
+    static constexpr size_t VECTOR_WORDS = 4;
+    static constexpr u32 MASK_SHIFT = 4; // 16 bits per word, see anchor_mask()
+#elif defined(__AVX2__)
+    static constexpr size_t VECTOR_WORDS = 8;
+    static constexpr u32 MASK_SHIFT = 0;
+#else
+    static constexpr size_t VECTOR_WORDS = 4;
+    static constexpr u32 MASK_SHIFT = 0;
+#endif
+
+    struct Anchor {
+        u32 value;
+        u32 mask;
+    };
+
+    // everything the scan needs from a pattern, kept in one place
+    struct Entry {
+        Anchor anchor;
+        const u32* value;
+        const u32* mask;
+        const u8* order; // see PatternData::order
+        u8 anchor_word; // index of the anchor in value/mask
+        u8 words;
+        u8 order_count;
+        u8 id; // user id, passed back to on_match
+    };
+
+    struct Piece {
+        const u8* data;
+        size_t size;
+        u64 offset; // in the stream
+    };
+
+    Entry entries[MAX_PATTERNS]{}; // only the unresolved patterns, in no particular order
+    Anchor anchors[MAX_PATTERNS]{}; // every distinct anchor of entries
+    u8 count{};
+    u8 anchor_count{};
+
+    Piece prev{};
+    Piece cur{};
+    u64 offset{}; // of the next piece
+    u8 window[MAX_PATTERN_SIZE]{}; // a pattern crossing two pieces is put together here
+
+    void update_anchors() {
+        anchor_count = 0;
+        for (u8 i = 0; i < count; i++) {
+            const auto& a = entries[i].anchor;
+            bool found{};
+            for (u8 j = 0; j < anchor_count && !found; j++) {
+                found = anchors[j].value == a.value && anchors[j].mask == a.mask;
+            }
+            if (!found) {
+                anchors[anchor_count++] = a;
+            }
+        }
+    }
+
+    // returns a mask of the words in the next VECTOR_WORDS where any anchor matches
+    auto anchor_mask(const u8* data) const -> u64 {
+#if defined(__ARM_NEON)
+        const auto d = vreinterpretq_u32_u8(vld1q_u8(data));
+        auto hit = vdupq_n_u32(0);
+        for (u8 i = 0; i < anchor_count; i++) {
+            const auto eq = vceqq_u32(vandq_u32(d, vdupq_n_u32(anchors[i].mask)), vdupq_n_u32(anchors[i].value));
+            hit = vorrq_u32(hit, eq);
+        }
+        // narrow to 16 bits per word, there's no movemask on neon
+        const auto narrowed = vshrn_n_u32(hit, 16);
+        return vget_lane_u64(vreinterpret_u64_u16(narrowed), 0) & 0x8000800080008000ULL;
+#elif defined(__AVX2__)
+        const auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        auto hit = _mm256_setzero_si256();
+        for (u8 i = 0; i < anchor_count; i++) {
+            const auto m = _mm256_set1_epi32(static_cast<int>(anchors[i].mask));
+            const auto v = _mm256_set1_epi32(static_cast<int>(anchors[i].value));
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi32(_mm256_and_si256(d, m), v));
+        }
+        return static_cast<u32>(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+#elif defined(__SSE2__)
+        const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        auto hit = _mm_setzero_si128();
+        for (u8 i = 0; i < anchor_count; i++) {
+            const auto m = _mm_set1_epi32(static_cast<int>(anchors[i].mask));
+            const auto v = _mm_set1_epi32(static_cast<int>(anchors[i].value));
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi32(_mm_and_si128(d, m), v));
+        }
+        return static_cast<u32>(_mm_movemask_ps(_mm_castsi128_ps(hit)));
+#else
+        return 0;
+#endif
+    }
+
+    // checks every pattern whose anchor matches inst, the instruction at word of the current piece
+    template<typename F>
+    void check_anchors(size_t word, u32 inst, F& on_match) {
+        const auto stream_word = cur.offset / 4 + word;
+        for (u8 i = 0; i < count;) {
+            const auto& e = entries[i];
+            if ((inst & e.anchor.mask) != e.anchor.value || stream_word < e.anchor_word) {
+                i++;
+                continue;
+            }
+
+            // the entry is replaced with the last one if it gets resolved, so check it again
+            if (!check_candidate(i, (stream_word - e.anchor_word) * 4, on_match)) {
+                i++;
+            }
+        }
+    }
+
+    // finishes the candidates that ran past the end of the previous piece.
+    // only a pattern whose anchor is in the last MAX_PATTERN_SIZE - 4 bytes of a piece can do so,
+    // so they're found again there instead of being kept, which keeps the scanner small
+    template<typename F>
+    void finish_prev(F& on_match) {
+        if (!prev.data) {
+            return;
+        }
+
+        const u64 prev_end = prev.offset + prev.size;
+        const u64 tail = prev.size < MAX_PATTERN_SIZE - 4 ? prev.size : MAX_PATTERN_SIZE - 4;
+        for (u64 word = (prev_end - tail) / 4; word < prev_end / 4 && count; word++) {
+            const auto inst = load_inst(prev.data + (word * 4 - prev.offset));
+            for (u8 i = 0; i < count;) {
+                const auto& e = entries[i];
+                if ((inst & e.anchor.mask) != e.anchor.value || word < e.anchor_word ||
+                    (word - e.anchor_word + e.words) * 4 <= prev_end) {
+                    i++;
+                    continue;
+                }
+
+                // the entry is replaced with the last one if it gets resolved, so check it again
+                if (!check_candidate(i, (word - e.anchor_word) * 4, on_match)) {
+                    i++;
+                }
+            }
+        }
+    }
+
+    // compares the pattern of entries[i] at start. one that doesn't fit yet is left for
+    // finish_prev() with the next piece. returns true if the pattern was resolved.
+    template<typename F>
+    auto check_candidate(u8 i, u64 start, F& on_match) -> bool {
+        const auto& e = entries[i];
+        const auto size = e.words * 4U;
+
+        if (start + size > cur.offset + cur.size) {
+            return false;
+        }
+
+        const auto match = match_at(start, size);
+        if (!match) {
+            return false;
+        }
+
+#if defined(SCANNER_STATS)
+        candidates++;
+#endif
+        if (!words_match(e, match) || !on_match(e.id, start, match)) {
+            return false;
+        }
+
+        // drop it by moving the last entry into its place, then drop the anchors that are no longer needed
+        entries[i] = entries[--count];
+        update_anchors();
+        return true;
+    }
+
+    // returns the bytes at [start, start + size) of the stream, which end in the current piece
+    auto match_at(u64 start, u32 size) -> const u8* {
+        if (start >= cur.offset) {
+            return cur.data + (start - cur.offset);
+        }
+
+        // crossing from the previous piece (or from before the stream, then there's nothing to compare)
+        if (!prev.data || start < prev.offset) {
+            return nullptr;
+        }
+
+        const auto in_prev = cur.offset - start;
+        if (prev.data + prev.size == cur.data) {
+            // both pieces are next to each other in memory
+            return cur.data - in_prev;
+        }
+
+        std::memcpy(window, prev.data + prev.size - in_prev, in_prev);
+        std::memcpy(window + in_prev, cur.data, size - in_prev);
+        return window;
+    }
+
+    // the anchor already matched, so only the rest of the words are compared
+    auto words_match(const Entry& e, const u8* data) -> bool {
+        for (u32 k = 0; k < e.order_count; k++) {
+            const auto i = e.order[k];
+#if defined(SCANNER_STATS)
+            compares++;
+#endif
+            if ((load_inst(data + i * 4) & e.mask[i]) != e.value[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// the main thread of the sysmodule only has a 0x1000 byte stack, a scanner has to stay well
+// below it, and is never to be copied onto the stack (see clear())
+static_assert(sizeof(MultiScanner) <= 0x800);
+
+constexpr auto make_crc32c_table() {
+    struct Table {
+        u32 data[256];
+    } table{};
+
+    for (u32 i = 0; i < 256; i++) {
+        u32 crc = i;
+        for (u32 bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0); // castagnoli, reflected
+        }
+        table.data[i] = crc;
+    }
+    return table;
+}
+
+constexpr auto CRC32C_TABLE = make_crc32c_table();
+
+#if defined(__ARM_FEATURE_CRC32) || defined(__SSE4_2__)
+constexpr bool HAS_HW_CRC32C = true;
+#else
+constexpr bool HAS_HW_CRC32C = false;
+#endif
+
+// crc32c of data, continuing from crc (0 to start).
+// uses the crc instructions 8 bytes at a time if there are any, the table otherwise.
+template<bool UseHw = HAS_HW_CRC32C>
+auto crc32c(u32 crc, const void* data, size_t size) -> u32 {
+    auto p = static_cast<const u8*>(data);
+    crc = ~crc;
+
+    if constexpr (UseHw) {
+        for (; size >= 8; p += 8, size -= 8) {
+            u64 v;
+            std::memcpy(&v, p, sizeof(v));
+#if defined(__ARM_FEATURE_CRC32)
+            crc = __crc32cd(crc, v);
+#elif defined(__SSE4_2__)
+            crc = static_cast<u32>(_mm_crc32_u64(crc, v));
+#endif
+        }
+    }
+
+    for (; size; p++, size--) {
+        crc = CRC32C_TABLE.data[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+} // namespace